@@ -0,0 +1,190 @@
+/*
+ * This file is part of Bialet, which is licensed under the
+ * MIT License.
+ *
+ * Copyright (c) 2023-2026 Rodrigo Arce
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * For full license text, see LICENSE.md.
+ */
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A VM with the core classes built takes about 700 KB, so a short request fits
+// in one chunk.
+#define ARENA_CHUNK_SIZE (1024 * 1024)
+#define ARENA_ALIGN (2 * sizeof(size_t))
+
+struct ArenaChunk {
+  struct ArenaChunk* next;
+  size_t             size;
+  size_t             used;
+  // Keeps the data that follows aligned to ARENA_ALIGN.
+  size_t             padding;
+};
+
+// Precedes every block. Wren does not pass the old size to the allocator, and
+// a grown block has to copy it.
+struct ArenaBlock {
+  size_t size;
+  size_t from_heap;
+};
+
+// A block past the limit. They are linked so the ones the VM never freed
+// (everything still alive when the arena is dropped) go with it.
+struct ArenaHeapBlock {
+  struct ArenaHeapBlock* prev;
+  struct ArenaHeapBlock* next;
+  struct ArenaBlock      block;
+};
+
+struct Arena {
+  struct ArenaChunk*     chunks;
+  struct ArenaHeapBlock* heap_blocks;
+  size_t             used;
+  size_t             limit;
+  size_t             heap;
+  size_t             heap_peak;
+};
+
+_Static_assert(sizeof(struct ArenaChunk) % ARENA_ALIGN == 0,
+               "chunk data must stay aligned");
+_Static_assert(sizeof(struct ArenaBlock) % ARENA_ALIGN == 0,
+               "block data must stay aligned");
+_Static_assert(sizeof(struct ArenaHeapBlock) % ARENA_ALIGN == 0,
+               "heap block data must stay aligned");
+
+struct Arena* arena_new(size_t limit) {
+  struct Arena* arena = calloc(1, sizeof(struct Arena));
+  if(arena != NULL)
+    arena->limit = limit;
+  return arena;
+}
+
+void arena_free(struct Arena* arena) {
+  if(arena == NULL)
+    return;
+  struct ArenaChunk* chunk = arena->chunks;
+  while(chunk != NULL) {
+    struct ArenaChunk* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  struct ArenaHeapBlock* heap_block = arena->heap_blocks;
+  while(heap_block != NULL) {
+    struct ArenaHeapBlock* next = heap_block->next;
+    free(heap_block);
+    heap_block = next;
+  }
+  free(arena);
+}
+
+size_t arena_peak(const struct Arena* arena) {
+  return arena->used + arena->heap_peak;
+}
+
+static struct ArenaBlock* arena_bump(struct Arena* arena, size_t size) {
+  size_t             need = sizeof(struct ArenaBlock) + size;
+  struct ArenaChunk* chunk = arena->chunks;
+  if(chunk == NULL || chunk->size - chunk->used < need) {
+    size_t capacity = need > ARENA_CHUNK_SIZE ? need : ARENA_CHUNK_SIZE;
+    chunk = malloc(sizeof(struct ArenaChunk) + capacity);
+    if(chunk == NULL)
+      return NULL;
+    chunk->size = capacity;
+    chunk->used = 0;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+  }
+  struct ArenaBlock* block =
+      (struct ArenaBlock*)((char*)(chunk + 1) + chunk->used);
+  chunk->used += need;
+  arena->used += need;
+  block->size = size;
+  block->from_heap = 0;
+  return block;
+}
+
+static struct ArenaHeapBlock* arena_heap_block(struct ArenaBlock* block) {
+  return (struct ArenaHeapBlock*)((char*)block - offsetof(struct ArenaHeapBlock, block));
+}
+
+static struct ArenaBlock* arena_heap(struct Arena* arena, size_t size) {
+  struct ArenaHeapBlock* heap_block = malloc(sizeof(struct ArenaHeapBlock) + size);
+  if(heap_block == NULL)
+    return NULL;
+  heap_block->prev = NULL;
+  heap_block->next = arena->heap_blocks;
+  if(arena->heap_blocks != NULL)
+    arena->heap_blocks->prev = heap_block;
+  arena->heap_blocks = heap_block;
+  heap_block->block.size = size;
+  heap_block->block.from_heap = 1;
+  arena->heap += size;
+  if(arena->heap > arena->heap_peak)
+    arena->heap_peak = arena->heap;
+  return &heap_block->block;
+}
+
+static void arena_release(struct Arena* arena, struct ArenaBlock* block) {
+  if(!block->from_heap)
+    return;
+  struct ArenaHeapBlock* heap_block = arena_heap_block(block);
+  if(heap_block->prev != NULL)
+    heap_block->prev->next = heap_block->next;
+  else
+    arena->heap_blocks = heap_block->next;
+  if(heap_block->next != NULL)
+    heap_block->next->prev = heap_block->prev;
+  arena->heap -= block->size;
+  free(heap_block);
+}
+
+// Whether [block] is the last one bumped out of the current chunk, which can
+// then grow in place. Buffers that double as they are written (code, constant
+// and list storage) usually are.
+static int arena_is_last(struct Arena* arena, struct ArenaBlock* block) {
+  struct ArenaChunk* chunk = arena->chunks;
+  return chunk != NULL && !block->from_heap &&
+         (char*)(block + 1) + block->size == (char*)(chunk + 1) + chunk->used;
+}
+
+void* arena_reallocate(void* memory, size_t new_size, void* user_data) {
+  struct Arena*      arena = user_data;
+  struct ArenaBlock* old = memory ? (struct ArenaBlock*)memory - 1 : NULL;
+
+  if(new_size == 0) {
+    if(old != NULL)
+      arena_release(arena, old);
+    return NULL;
+  }
+
+  new_size = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+  if(old != NULL && new_size <= old->size)
+    return memory;
+
+  if(old != NULL && arena_is_last(arena, old) &&
+     arena->chunks->size - arena->chunks->used >= new_size - old->size &&
+     arena->used + new_size - old->size <= arena->limit) {
+    arena->chunks->used += new_size - old->size;
+    arena->used += new_size - old->size;
+    old->size = new_size;
+    return memory;
+  }
+
+  struct ArenaBlock* block = arena->used + new_size <= arena->limit
+                                 ? arena_bump(arena, new_size)
+                                 : arena_heap(arena, new_size);
+  if(block == NULL)
+    return NULL;
+  if(old != NULL) {
+    memcpy(block + 1, memory, old->size);
+    arena_release(arena, old);
+  }
+  return block + 1;
+}
@@ -0,0 +1,35 @@
+/*
+ * This file is part of Bialet, which is licensed under the
+ * MIT License.
+ *
+ * Copyright (c) 2023-2026 Rodrigo Arce
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * For full license text, see LICENSE.md.
+ */
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Memory for a VM that lives for a single request (see --arena). Allocations
+// are bumped out of large chunks and never freed one by one; the whole arena
+// is dropped with arena_free() once the VM is gone.
+//
+// Past [limit] bytes new blocks come from malloc and are freed normally, so a
+// long cron job or migration that keeps allocating and collecting does not
+// grow the arena without bound. The ones still alive go with the arena.
+struct Arena;
+
+struct Arena* arena_new(size_t limit);
+void          arena_free(struct Arena* arena);
+
+// A WrenReallocateFn, with the arena as [user_data].
+void* arena_reallocate(void* memory, size_t new_size, void* user_data);
+
+// Bytes handed out so far, dead blocks included, plus the most that was ever
+// allocated past the limit at once. The high-water mark of the request.
+size_t arena_peak(const struct Arena* arena);
+
+#endif
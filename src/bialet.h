@@ -68,6 +68,8 @@ char* realpath_n(const char* path, char* resolved, size_t resolved_size);
 #define BIALET_EXTENSION_LEN 5
 #define BIALET_DEFAULT_PORT 7001
 #define BIALET_DEFAULT_HOST "127.0.0.1"
+#define BIALET_MAX_WORKERS 64
+#define BIALET_DEFAULT_BACKLOG 511
 
 struct BialetConfig {
   char* root_dir;
@@ -98,6 +100,28 @@ struct BialetConfig {
   int sqlite_foreign_keys; /* Default: 1 (ON) */
   int sqlite_synchronous;  /* 0=OFF, 1=NORMAL, 2=FULL, 3=EXTRA; Default: 1 */
 
+  /* Number of HTTP worker processes forked by the supervisor (-W, default 1).
+   * Each worker has its own SQLite connection and, where SO_REUSEPORT is
+   * available, its own listening socket. */
+  int workers;
+
+  /* Listener settings. socket_path (--socket) listens on a Unix domain socket
+   * instead of host/port. backlog is passed to listen(); the TCP options are
+   * off by default and tcp_fastopen holds the pending TFO queue length. */
+  char* socket_path;
+  int   backlog;
+  int   tcp_nodelay;
+  int   tcp_defer_accept;
+  int   tcp_fastopen;
+
+  /* Reuse the bytecode of unchanged modules between requests (default 1,
+   * --no-bytecode-cache turns it off). */
+  int bytecode_cache;
+
+  /* Run each request on a fresh VM allocated from an arena instead of the
+   * warm VM (--arena). */
+  int arena;
+
   /* Set to true when running tests with -T flag */
   int enable_tests;
 };
@@ -111,52 +135,16 @@ struct BialetResponse {
    * static strings or buffers owned elsewhere, e.g. file_content). */
   int body_owned;
   int header_owned;
+  /* Set instead of body when the response is a Response.file() blob: the
+   * server streams [length] bytes from this BIALET_FILES row rather than
+   * loading the whole file. */
+  long long file_id;
+  /* Set when body points into a string of the warm VM [body_vm] instead of
+   * a copy. The string stays alive until bialet_response_release(). */
+  struct WrenHandle* body_ref;
+  struct WrenVM*     body_vm;
 };
 
-typedef enum {
-  BIALETQUERYTYPE_NULL,
-  BIALETQUERYTYPE_NUMBER,
-  BIALETQUERYTYPE_STRING,
-  BIALETQUERYTYPE_BLOB,
-  BIALETQUERYTYPE_BOOLEAN
-} BialetQueryType;
-
-typedef struct {
-  char*           name;
-  char*           value;
-  int             size;
-  BialetQueryType type;
-} BialetQueryRow;
-
-typedef struct {
-  BialetQueryRow* rows;
-  int             rowCount;
-} BialetQueryResult;
-
-typedef struct {
-  char*           value;
-  BialetQueryType type;
-} BialetQueryParameter;
-
-typedef struct {
-  BialetQueryResult*    results;
-  int                   resultsCount;
-  BialetQueryParameter* parameters;
-  int                   parametersCount;
-  char*                 queryString;
-  char*                 lastInsertId;
-} BialetQuery;
-
-BialetQuery* create_bialet_query();
-/* Returns 0 on success, -1 when the result/row/parameter could not be grown
- * (allocation failure). Callers must not use the failed slot and should abort
- * the query rather than dereference the un-grown array. */
-int  add_result_row(BialetQuery* query, int resultIndex, const char* name,
-                    const char* value, int size, BialetQueryType type);
-int  add_result(BialetQuery* query);
-int  add_parameter(BialetQuery* query, const char* value, BialetQueryType type);
-void free_bialet_query(BialetQuery* query);
-
 /* Welcome, not found and error pages */
 #define BIALET_HEADERS "Content-Type: text/html; charset=UTF-8\r\n"
 /* Shared page chrome. Bialet's brand palette (BRAND.md), hardcoded so the
@@ -10,10 +10,13 @@
  */
 #include "bialet_wren.h"
 
+#include "arena.h"
+
 #include "bialet.h"
 #include "http_call.h"
 #include "livereload.h"
 #include "messages.h"
+#include "query_cache.h"
 #include "server.h"
 #include "show_errors.h"
 #include "utils.h"
@@ -46,7 +49,6 @@
 #define BIALET_SQLITE_CACHE_SIZE "-10000"     // It's in kb, so 10 mb
 #define MAX_URL_LEN 1024
 #define MAX_LINE_ERROR_LEN 100
-#define MAX_COLUMNS 100
 #define MAX_MODULE_LEN 256
 #define HTTP_OK 200
 #define HTTP_ERROR 500
@@ -61,6 +63,26 @@
 #define MAIN_MODULE_SOURCE "Response.init\nDate.init(\"\")"
 #define CLI_MODULE_NAME "bialet_cli"
 
+// A worker serves requests on one warm VM, recycled after this many requests
+// (or after any error) so the method symbol table and heap cannot grow
+// without bound.
+#define BIALET_WARM_VM_MAX_REQUESTS 1000
+// With --arena, a VM spills past this many bytes to malloc (see arena.h). Its
+// first GC is put off until half of that is live: nothing a collection frees
+// is reused before the arena is full, so for a short request it would only
+// walk the heap. Block headers and rounding make the arena fill up ahead of
+// the GC's count, hence half.
+#define BIALET_ARENA_LIMIT (64 * 1024 * 1024)
+// Routes whose arena high-water marks are tracked, the rest are added up
+// under "other".
+#define BIALET_ARENA_ROUTES 256
+
+// Prepared statements kept per connection, see stmt_acquire().
+#define BIALET_STMT_CACHE_SIZE 64
+// Room for the names of the tables a statement reads, and for those it writes,
+// see stmt_authorize().
+#define BIALET_STMT_TABLES_LEN 1024
+
 // Maximum number of file parts accepted per multipart request. Without this
 // cap a 10MB body split into tens of thousands of tiny parts would force that
 // many synchronous INSERT statements and unbounded WAL/disk growth.
@@ -100,17 +122,290 @@ void bialet_test_mark_skip(void) {
   test_skip_requested = 1;
 }
 
+// Every query used to be prepared with sqlite3_prepare_v2 and finalized as
+// soon as it was done, so the same SQL was parsed and planned again on every
+// request. Statements are now kept here, keyed by their SQL text, and reset
+// for the next query with the same text. Once the cache is full the least
+// recently used one is finalized.
+//
+// A statement that is still running when its SQL comes up again is not
+// shared: the second one is prepared apart and finalized when released.
+// Statements that change the schema are never kept, and clear the cache, so
+// no statement outlives the tables it was planned against.
+//
+// Each one also keeps the tables it reads and the tables it writes, for the
+// query cache to know what to invalidate. NULL when they could not all be
+// recorded.
+struct StmtCacheEntry {
+  char*         sql;
+  size_t        sql_len;
+  unsigned long hash;
+  sqlite3_stmt* stmt;
+  unsigned long last_used;
+  int           in_use;
+  char*         reads;
+  char*         writes;
+};
+
+// Table names recorded while a statement is prepared, each one followed by a
+// newline, in lower case and once.
+struct StmtTables {
+  char   names[BIALET_STMT_TABLES_LEN];
+  size_t length;
+  int    overflow;
+};
+
+static struct StmtCacheEntry stmt_cache[BIALET_STMT_CACHE_SIZE];
+static int                   stmt_cache_count = 0;
+static unsigned long         stmt_cache_clock = 0;
+static long                  stmt_cache_hits = 0;
+static long                  stmt_cache_misses = 0;
+static int                   stmt_changes_schema = 0;
+static struct StmtTables     stmt_reads;
+static struct StmtTables     stmt_writes;
+// The last statement that may have changed the schema, and the schema version
+// the query cache was filled with.
+static sqlite3_stmt*         schema_stmt = NULL;
+static int                   schema_version = -1;
+
+static unsigned long stmt_hash(const char* sql, size_t length) {
+  unsigned long hash = 5381;
+  for(size_t i = 0; i < length; i++)
+    hash = hash * 33 + (unsigned char)sql[i];
+  return hash;
+}
+
+// Finalizes every cached statement. One that is still running is only
+// dropped from the cache, and stmt_release() finalizes it.
+static void stmt_cache_clear(void) {
+  for(int i = 0; i < stmt_cache_count; i++) {
+    if(!stmt_cache[i].in_use)
+      sqlite3_finalize(stmt_cache[i].stmt);
+    free(stmt_cache[i].sql);
+    free(stmt_cache[i].reads);
+    free(stmt_cache[i].writes);
+  }
+  stmt_cache_count = 0;
+}
+
+// Adds [table] to [tables].
+static void stmt_record_table(struct StmtTables* tables, const char* table) {
+  char   name[QUERY_CACHE_TABLE_LEN + 1];
+  size_t length = 0;
+  for(; table[length] != '\0'; length++) {
+    if(length == QUERY_CACHE_TABLE_LEN) {
+      tables->overflow = 1;
+      return;
+    }
+    name[length] = (char)tolower((unsigned char)table[length]);
+  }
+  name[length++] = '\n';
+  for(size_t at = 0; at < tables->length;) {
+    const char* end = memchr(tables->names + at, '\n', tables->length - at);
+    if((size_t)(end - tables->names - at) + 1 == length &&
+       memcmp(tables->names + at, name, length) == 0)
+      return;
+    at = (size_t)(end - tables->names) + 1;
+  }
+  if(tables->length + length >= sizeof(tables->names)) {
+    tables->overflow = 1;
+    return;
+  }
+  memcpy(tables->names + tables->length, name, length);
+  tables->length += length;
+}
+
+// A copy of [tables] as a string, or NULL when some were not recorded.
+static char* stmt_tables_copy(const struct StmtTables* tables) {
+  char* copy = tables->overflow ? NULL : malloc(tables->length + 1);
+  if(copy != NULL) {
+    memcpy(copy, tables->names, tables->length);
+    copy[tables->length] = '\0';
+  }
+  return copy;
+}
+
+// Called by SQLite while it prepares a statement.
+static int stmt_authorize(void* data, int action, const char* a, const char* b,
+                          const char* c, const char* d) {
+  (void)data;
+  (void)b;
+  (void)c;
+  (void)d;
+  switch(action) {
+    case SQLITE_READ:
+      if(a != NULL)
+        stmt_record_table(&stmt_reads, a);
+      break;
+    // The update hook misses WITHOUT ROWID tables and a DELETE of every row,
+    // so the tables a statement writes are known before it runs too.
+    case SQLITE_INSERT:
+    case SQLITE_UPDATE:
+    case SQLITE_DELETE:
+      if(a != NULL)
+        stmt_record_table(&stmt_writes, a);
+      break;
+    case SQLITE_ALTER_TABLE:
+    case SQLITE_CREATE_INDEX:
+    case SQLITE_CREATE_TABLE:
+    case SQLITE_CREATE_TEMP_INDEX:
+    case SQLITE_CREATE_TEMP_TABLE:
+    case SQLITE_CREATE_TEMP_TRIGGER:
+    case SQLITE_CREATE_TEMP_VIEW:
+    case SQLITE_CREATE_TRIGGER:
+    case SQLITE_CREATE_VIEW:
+    case SQLITE_CREATE_VTABLE:
+    case SQLITE_DROP_INDEX:
+    case SQLITE_DROP_TABLE:
+    case SQLITE_DROP_TEMP_INDEX:
+    case SQLITE_DROP_TEMP_TABLE:
+    case SQLITE_DROP_TEMP_TRIGGER:
+    case SQLITE_DROP_TEMP_VIEW:
+    case SQLITE_DROP_TRIGGER:
+    case SQLITE_DROP_VIEW:
+    case SQLITE_DROP_VTABLE:
+      stmt_changes_schema = 1;
+      break;
+    // Another database may have tables with the same names.
+    case SQLITE_ATTACH:
+    case SQLITE_DETACH:
+      stmt_changes_schema = 2;
+      break;
+  }
+  return SQLITE_OK;
+}
+
+// Returns a statement for [sql] with no bindings, for stmt_release() to take
+// back, or NULL when it does not compile (the error is in sqlite3_errmsg) or
+// has nothing to run.
+static sqlite3_stmt* stmt_acquire(const char* sql) {
+  size_t        sql_len = strlen(sql);
+  unsigned long hash = stmt_hash(sql, sql_len);
+  for(int i = 0; i < stmt_cache_count; i++) {
+    struct StmtCacheEntry* entry = &stmt_cache[i];
+    if(entry->in_use || entry->hash != hash || entry->sql_len != sql_len ||
+       memcmp(entry->sql, sql, sql_len) != 0)
+      continue;
+    entry->in_use = 1;
+    entry->last_used = ++stmt_cache_clock;
+    stmt_cache_hits++;
+    return entry->stmt;
+  }
+
+  stmt_cache_misses++;
+  sqlite3_stmt* stmt = NULL;
+  stmt_changes_schema = 0;
+  stmt_reads.length = 0;
+  stmt_reads.overflow = 0;
+  stmt_writes.length = 0;
+  stmt_writes.overflow = 0;
+  if(sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK || stmt == NULL)
+    return NULL;
+  if(stmt_changes_schema) {
+    stmt_cache_clear();
+    if(stmt_changes_schema == 2)
+      query_cache_clear();
+    schema_stmt = stmt;
+    return stmt;
+  }
+
+  struct StmtCacheEntry* slot = NULL;
+  if(stmt_cache_count < BIALET_STMT_CACHE_SIZE) {
+    slot = &stmt_cache[stmt_cache_count];
+  } else {
+    for(int i = 0; i < stmt_cache_count; i++) {
+      if(!stmt_cache[i].in_use &&
+         (slot == NULL || stmt_cache[i].last_used < slot->last_used))
+        slot = &stmt_cache[i];
+    }
+  }
+  char* copy = slot != NULL ? malloc(sql_len + 1) : NULL;
+  if(copy == NULL)
+    return stmt;
+  memcpy(copy, sql, sql_len + 1);
+
+  if(slot == &stmt_cache[stmt_cache_count]) {
+    stmt_cache_count++;
+  } else {
+    sqlite3_finalize(slot->stmt);
+    free(slot->sql);
+    free(slot->reads);
+    free(slot->writes);
+  }
+  slot->sql = copy;
+  slot->reads = stmt_tables_copy(&stmt_reads);
+  slot->writes = stmt_tables_copy(&stmt_writes);
+  slot->sql_len = sql_len;
+  slot->hash = hash;
+  slot->stmt = stmt;
+  slot->last_used = ++stmt_cache_clock;
+  slot->in_use = 1;
+  return stmt;
+}
+
+// The versions of the main and temp schemas added up, which grows whenever
+// either of them changes.
+static int stmt_schema_version(void) {
+  const char* pragmas[] = {"PRAGMA main.schema_version", "PRAGMA temp.schema_version"};
+  int         version = 0;
+  for(int i = 0; i < 2; i++) {
+    sqlite3_stmt* stmt = NULL;
+    if(sqlite3_prepare_v2(db, pragmas[i], -1, &stmt, NULL) == SQLITE_OK &&
+       stmt != NULL && sqlite3_step(stmt) == SQLITE_ROW)
+      version += sqlite3_column_int(stmt, 0);
+    sqlite3_finalize(stmt);
+  }
+  return version;
+}
+
+// Drops the cached queries that read what [stmt] wrote, once it is done with
+// them. Without the tables it writes, every cached query is dropped.
+static void stmt_invalidate(sqlite3_stmt* stmt, const char* writes) {
+  if(writes != NULL)
+    query_cache_invalidate_tables(writes);
+  else if(!sqlite3_stmt_readonly(stmt))
+    query_cache_clear();
+}
+
+static void stmt_release(sqlite3_stmt* stmt) {
+  if(stmt == NULL)
+    return;
+  for(int i = 0; i < stmt_cache_count; i++) {
+    if(stmt_cache[i].stmt == stmt) {
+      sqlite3_reset(stmt);
+      sqlite3_clear_bindings(stmt);
+      stmt_cache[i].in_use = 0;
+      stmt_invalidate(stmt, stmt_cache[i].writes);
+      return;
+    }
+  }
+  int changed_schema = stmt == schema_stmt;
+  if(!changed_schema)
+    stmt_invalidate(stmt, NULL);
+  sqlite3_finalize(stmt);
+  // Most apps run their CREATE TABLE IF NOT EXISTS on every request, which
+  // would empty the query cache each time. It is only emptied when the schema
+  // did change.
+  if(changed_schema) {
+    schema_stmt = NULL;
+    int version = stmt_schema_version();
+    if(version != schema_version) {
+      schema_version = version;
+      query_cache_clear();
+    }
+  }
+}
+
 static void bialet_wren_write(WrenVM* vm, const char* message) {
   (void)vm;
   message(yellow("Log"), message);
   // A failed prepare (e.g. SQLITE_BUSY on the shared connection) leaves stmt
   // NULL; binding/stepping it would NULL-deref the request thread.
-  sqlite3_stmt* stmt = NULL;
-  if(sqlite3_prepare_v2(db, "INSERT INTO BIALET_LOGS (message) VALUES (?)", -1,
-                        &stmt, 0) == SQLITE_OK) {
+  sqlite3_stmt* stmt = stmt_acquire("INSERT INTO BIALET_LOGS (message) VALUES (?)");
+  if(stmt != NULL) {
     sqlite3_bind_text(stmt, 1, message, -1, SQLITE_STATIC);
     sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    stmt_release(stmt);
   }
 }
 
@@ -233,10 +528,10 @@ static WrenLoadModuleResult bialet_wren_load_module(WrenVM* vm, const char* name
       message(red("Error"), "Import type not supported.");
       return result;
     }
-    sqlite3_stmt* stmt = NULL;
-    if(sqlite3_prepare_v2(
-           db, "SELECT content FROM BIALET_REMOTE_MODULES WHERE module = ? LIMIT 1",
-           -1, &stmt, 0) == SQLITE_OK) {
+    sqlite3_stmt* stmt =
+        stmt_acquire("SELECT content FROM BIALET_REMOTE_MODULES WHERE module = ? "
+                     "LIMIT 1");
+    if(stmt != NULL) {
       sqlite3_bind_text(stmt, 1, name, -1, SQLITE_STATIC);
       const char* content = 0;
       if(sqlite3_step(stmt) == SQLITE_ROW) {
@@ -244,7 +539,7 @@ static WrenLoadModuleResult bialet_wren_load_module(WrenVM* vm, const char* name
         result.source = string_safe_copy(content);
         result.onComplete = bialet_wren_free_module_source;
       }
-      sqlite3_finalize(stmt);
+      stmt_release(stmt);
     }
     if(result.source != NULL)
       return result;
@@ -422,154 +717,45 @@ void bialet_wren_error(WrenVM* vm, WrenErrorType errorType, const char* module,
   }
 }
 
-static char* sqlite_int_to_string(sqlite3_int64 value) {
-  char* str = (char*)malloc(21 * sizeof(char));
-  if(str == NULL)
-    return NULL;
-  snprintf(str, 21, "%lld", value);
-  return str;
-}
-
-static void query_execute(WrenVM* vm, BialetQuery* query) {
-  (void)vm;
-  sqlite3_stmt* stmt;
-  const char*   columns[MAX_COLUMNS];
-  int           colType, colCount = 0, rowCount = 0, bindCounter = 0;
-
-  // Check if the query string contains only whitespace
-  const char* str = query->queryString;
-  int         isEmpty = 1; // Assume the string is empty or contains only whitespaces
-  while(*str) {
-    if(!isspace((unsigned char)*str)) {
-      isEmpty = 0; // Found a non-whitespace character
-      break;
-    }
-    str++;
-  }
+sqlite3_stmt* bialet_query_prepare(const char* sql) {
   // Ignore empty queries
-  if(isEmpty)
-    return;
+  const char* str = sql;
+  while(isspace((unsigned char)*str))
+    str++;
+  if(*str == '\0' || db == NULL)
+    return NULL;
 
-  /* Prepare the query */
-  int result = sqlite3_prepare_v2(db, query->queryString, -1, &stmt, 0);
-  if(result != SQLITE_OK) {
+  sqlite3_stmt* stmt = stmt_acquire(sql);
+  if(stmt == NULL && sqlite3_errcode(db) != SQLITE_OK)
     message(red("Query Error"), sqlite3_errmsg(db));
-    return;
-  }
-
-  /* Bind parameters */
-  for(int i = 0; i < query->parametersCount; i++) {
-    bindCounter = i + 1;
-    switch(query->parameters[i].type) {
-      case BIALETQUERYTYPE_STRING:
-        sqlite3_bind_text(stmt, bindCounter, query->parameters[i].value, -1,
-                          SQLITE_STATIC);
-        break;
-      case BIALETQUERYTYPE_NUMBER:
-        sqlite3_bind_double(stmt, bindCounter, atof(query->parameters[i].value));
-        break;
-      case BIALETQUERYTYPE_BOOLEAN:
-        sqlite3_bind_int(stmt, bindCounter, atoi(query->parameters[i].value));
-        break;
-      case BIALETQUERYTYPE_NULL:
-        sqlite3_bind_null(stmt, bindCounter);
-        break;
-      default:
-        message(red("Query Error"), "Uknown type on binding parameters");
-        sqlite3_finalize(stmt);
-        return;
-    }
-  }
-
-  /* Execute statement and fetch results */
-  int alloc_error = 0;
-  while((result = sqlite3_step(stmt)) == SQLITE_ROW) {
-    if(!colCount) {
-      /* Get column names */
-      colCount = sqlite3_column_count(stmt);
-      if(colCount > MAX_COLUMNS)
-        colCount = MAX_COLUMNS;
-      for(int i = 0; i < colCount; i++) {
-        columns[i] = sqlite3_column_name(stmt, i);
-      }
-    }
+  return stmt;
+}
 
-    if(add_result(query) != 0) {
-      alloc_error = 1;
-      break;
-    }
-    for(int i = 0; i < colCount; i++) {
-      /* Initialized per column. These were declared once outside the loop and
-       * the `default:` branch below only logged before falling through to
-       * add_result_row(), which then used whatever the *previous* column left
-       * behind -- or, on the first column, indeterminate values. */
-      const char* value = NULL;
-      int         size = 0;
-      int         type = BIALETQUERYTYPE_NULL;
-
-      colType = sqlite3_column_type(stmt, i);
-      switch(colType) {
-        case SQLITE_INTEGER:
-        case SQLITE_FLOAT:
-        case SQLITE_TEXT:
-          type = colType == SQLITE_TEXT ? BIALETQUERYTYPE_STRING
-                                        : BIALETQUERYTYPE_NUMBER;
-          value = (const char*)sqlite3_column_text(stmt, i);
-          /* sqlite3_column_text returns NULL if the conversion cannot be
-           * allocated; strlen() on it was an unconditional NULL dereference. */
-          if(value == NULL) {
-            alloc_error = 1;
-          } else {
-            size = (int)strlen(value);
-          }
-          break;
-        case SQLITE_BLOB:
-          type = BIALETQUERYTYPE_BLOB;
-          /* Note: BLOB data is retrieved correctly from SQLite but may not be
-           * properly passed to Wren as binary data. This is due to Wren's string
-           * representation. Consider converting BLOBs to base64 strings or handling
-           * them as byte arrays if Wren adds support for binary data types. */
-          value = sqlite3_column_blob(stmt, i);
-          size = sqlite3_column_bytes(stmt, i);
-          break;
-        case SQLITE_NULL:
-          type = BIALETQUERYTYPE_NULL;
-          value = NULL;
-          size = 1;
-          break;
-        default:
-          message(red("Query Error"), "Unknown type on binding result");
-          continue; /* skip this column instead of falling through */
-      }
-      if(alloc_error)
-        break;
-      if(add_result_row(query, rowCount, columns[i], value, size, type) != 0) {
-        alloc_error = 1;
-        break;
-      }
-    }
-    rowCount++;
+const char* bialet_query_reads(sqlite3_stmt* stmt) {
+  for(int i = 0; i < stmt_cache_count; i++) {
+    if(stmt_cache[i].stmt == stmt)
+      return stmt_cache[i].reads;
   }
+  return NULL;
+}
 
-  if(alloc_error) {
-    message(red("Query Error"), "Out of memory while collecting query results");
-  }
+static void query_cache_update(void* data, int op, const char* database,
+                               const char* table, sqlite3_int64 rowid) {
+  (void)data;
+  (void)op;
+  (void)database;
+  (void)rowid;
+  query_cache_invalidate(table);
+}
 
-  /* Check for errors during query execution.
-   * SQLITE_DONE means all rows have been fetched successfully.
-   * SQLITE_OK is also acceptable (though less common after stepping).
-   * Any other result code indicates an error that should be reported.
-   * Note: SQLITE_MISUSE can occur from incorrect API usage such as:
-   * - Using a finalized statement
-   * - Using a statement from a different thread
-   * - Calling sqlite3_step after it has returned SQLITE_DONE
-   * This error handling ensures proper cleanup even on errors. */
-  if(result != SQLITE_DONE && result != SQLITE_OK) {
+void bialet_query_release(sqlite3_stmt* stmt, int result) {
+  /* SQLITE_DONE means all rows have been fetched, anything else but a row
+   * still pending is an error that should be reported. */
+  if(result != SQLITE_DONE && result != SQLITE_OK && result != SQLITE_ROW)
     message(red("SQL Error"), sqlite3_errmsg(db));
-  }
-  query->lastInsertId = sqlite_int_to_string(sqlite3_last_insert_rowid(db));
-  sqlite3_finalize(stmt);
+  stmt_release(stmt);
 }
+
 char* escape_special_chars(const char* input) {
   size_t i, j = 0, len = strlen(input);
   char*  output = malloc(len * 2 + 1);
@@ -631,9 +817,10 @@ static size_t copy_until(const char* src, size_t avail, const char* delims,
   return n;
 }
 
-int save_uploaded_files(struct HttpMessage* hm, char* filesIds) {
-  filesIds[0] = '\0'; // Initialize empty string
-
+// Saves the first file uploaded as the form field [name] in the multipart
+// body of [hm] to BIALET_FILES, and returns its id, or 0. Uploads used to be
+// saved before the handler ran, all of them, whether it read them or not.
+static sqlite3_int64 save_uploaded_file(struct HttpMessage* hm, const char* name) {
   const char* msg = hm->message.str;
   size_t      msg_len = hm->message.len;
   if(msg == NULL || msg_len == 0)
@@ -696,9 +883,9 @@ int save_uploaded_files(struct HttpMessage* hm, char* filesIds) {
   size_t sb_len = (size_t)sb;
   size_t dl_len = (size_t)dl;
 
-  const char* cursor = mem_find(body, (size_t)(end - body), startBoundary, sb_len);
-  int         firstFile = 1;
-  int         uploadedFiles = 0;
+  const char*   cursor = mem_find(body, (size_t)(end - body), startBoundary, sb_len);
+  int           uploadedFiles = 0;
+  sqlite3_int64 fileId = 0;
 
   while(cursor != NULL) {
     const char* part = cursor + sb_len;
@@ -790,23 +977,26 @@ int save_uploaded_files(struct HttpMessage* hm, char* filesIds) {
       continue;
     }
 
-    // Skip further parts once the per-request file count cap is reached so a
-    // single request cannot insert an unbounded number of rows into
-    // BIALET_FILES (CPU/disk amplification).
+    // Parts past the per-request file count cap are ignored, so a single
+    // request cannot insert an unbounded number of rows into BIALET_FILES
+    // (CPU/disk amplification).
     if(uploadedFiles >= MAX_UPLOAD_FILES) {
       message(red("Upload Error"), "Too many files in request, skipping rest");
       break;
     }
+    uploadedFiles++;
+    if(strcmp(fieldName, name) != 0) {
+      cursor = resume
+                   ? mem_find(resume, (size_t)(end - resume), startBoundary, sb_len)
+                   : NULL;
+      continue;
+    }
 
     // Save file to database
-    sqlite3_stmt* stmt = NULL;
-    int           result = sqlite3_prepare_v2(db,
-                                              "INSERT INTO BIALET_FILES (name, "
-                                                        "originalFileName, type, file, size, isTemp) "
-                                                        "VALUES (?, ?, ?, ?, ?, 1)",
-                                              -1, &stmt, 0);
-
-    if(result == SQLITE_OK) {
+    sqlite3_stmt* stmt = stmt_acquire("INSERT INTO BIALET_FILES (name, "
+                                      "originalFileName, type, file, size, isTemp) "
+                                      "VALUES (?, ?, ?, ?, ?, 1)");
+    if(stmt != NULL) {
       sqlite3_bind_text(stmt, 1, fieldName, -1, SQLITE_STATIC);
       sqlite3_bind_text(stmt, 2, filename, -1, SQLITE_STATIC);
       sqlite3_bind_text(stmt, 3, contentTypeStr, -1, SQLITE_STATIC);
@@ -814,36 +1004,15 @@ int save_uploaded_files(struct HttpMessage* hm, char* filesIds) {
                           SQLITE_STATIC);
       sqlite3_bind_int64(stmt, 5, (sqlite3_int64)fileSize);
 
-      if(sqlite3_step(stmt) == SQLITE_DONE) {
-        sqlite3_int64 fileId = sqlite3_last_insert_rowid(db);
-
-        // Append file ID to filesIds string safely
-        char idStr[32];
-        snprintf(idStr, sizeof(idStr), "%lld", fileId);
-
-        size_t currentLen = strlen(filesIds);
-        size_t neededLen = currentLen + (firstFile ? 0 : 1) + strlen(idStr);
-
-        if(neededLen < MAX_URL_LEN) {
-          if(!firstFile) {
-            strncat(filesIds, ",", MAX_URL_LEN - currentLen - 1);
-          }
-          strncat(filesIds, idStr, MAX_URL_LEN - strlen(filesIds) - 1);
-          firstFile = 0;
-        } else {
-          message(red("Upload Error"), "Too many files uploaded");
-        }
-      } else {
+      if(sqlite3_step(stmt) == SQLITE_DONE)
+        fileId = sqlite3_last_insert_rowid(db);
+      else
         message(red("Upload Error"), sqlite3_errmsg(db));
-      }
-      sqlite3_finalize(stmt);
-      uploadedFiles++;
+      stmt_release(stmt);
     } else {
       message(red("Upload Error"), sqlite3_errmsg(db));
     }
-
-    cursor = resume ? mem_find(resume, (size_t)(end - resume), startBoundary, sb_len)
-                    : NULL;
+    break;
   }
 
   // Steady-state recovery for BIALET_FILES: without a purge the temp blobs
@@ -866,9 +1035,557 @@ int save_uploaded_files(struct HttpMessage* hm, char* filesIds) {
     }
   }
 
+  return fileId;
+}
+
+// The request used to be handed to Request.init as one string and taken
+// apart in Wren: split into lines, every header split on ":" and joined
+// back, the query and body decoded one piece at a time, each step a new
+// string. It is now parsed here in a single pass and Request.init receives
+// the maps already built. The rules are the ones of the Wren parser, which
+// Request.parseQuery and Cookie.parseHeader still follow.
+static int request_is_space(char c) {
+  return c == '\t' || c == '\r' || c == '\n' || c == ' ';
+}
+
+// Narrows [*start, *end) to drop what Wren's String.trim() drops.
+static void request_trim(const char** start, const char** end) {
+  while(*start < *end && request_is_space(**start))
+    (*start)++;
+  while(*end > *start && request_is_space((*end)[-1]))
+    (*end)--;
+}
+
+// The URL-decoded [length] bytes at [src], decoded through [scratch].
+static Value request_decoded(WrenVM* vm, const char* src, size_t length,
+                             char* scratch) {
+  size_t decoded = url_decode(src, length, scratch);
+  return wrenNewStringLength(vm, scratch, decoded);
+}
+
+// The map Request.parseQuery() returns for the [length] bytes at [query].
+// [scratch] must hold [length] bytes.
+static Value request_query_map(WrenVM* vm, const char* query, size_t length,
+                               char* scratch) {
+  ObjMap* map = wrenNewMap(vm);
+  const char* start = query;
+  const char* end = query + length;
+  request_trim(&start, &end);
+  if(start == end)
+    return OBJ_VAL(map);
+
+  wrenPushRoot(vm, (Obj*)map);
+  const char* pair = start;
+  while(pair <= end) {
+    const char* pair_end = memchr(pair, '&', (size_t)(end - pair));
+    if(pair_end == NULL)
+      pair_end = end;
+    const char* equals = memchr(pair, '=', (size_t)(pair_end - pair));
+    const char* key_end = equals ? equals : pair_end;
+    Value       key = request_decoded(vm, pair, (size_t)(key_end - pair), scratch);
+    wrenPushRoot(vm, AS_OBJ(key));
+    Value value = TRUE_VAL;
+    if(equals != NULL) {
+      // Only what is between the first and a second "=" is the value.
+      const char* value_start = equals + 1;
+      const char* value_end =
+          memchr(value_start, '=', (size_t)(pair_end - value_start));
+      if(value_end == NULL)
+        value_end = pair_end;
+      value = request_decoded(vm, value_start, (size_t)(value_end - value_start),
+                              scratch);
+      wrenPushRoot(vm, AS_OBJ(value));
+    }
+    wrenMapSet(vm, map, key, value);
+    if(equals != NULL)
+      wrenPopRoot(vm);
+    wrenPopRoot(vm);
+    pair = pair_end + 1;
+  }
+  wrenPopRoot(vm);
+  return OBJ_VAL(map);
+}
+
+// Builds in [slot] the map Cookie.parseHeader() keeps for a Cookie header.
+// Slots 8 and 9 hold each name and value.
+static void request_cookie_map(WrenVM* vm, int slot, const char* header,
+                               size_t length) {
+  wrenSetSlotNewMap(vm, slot);
+  const char* end = header + length;
+  const char* cookie = header;
+  while(cookie <= end) {
+    const char* cookie_end = memchr(cookie, ';', (size_t)(end - cookie));
+    if(cookie_end == NULL)
+      cookie_end = end;
+    const char* equals = memchr(cookie, '=', (size_t)(cookie_end - cookie));
+    if(equals != NULL) {
+      const char* name = cookie;
+      const char* name_end = equals;
+      const char* value = equals + 1;
+      const char* value_end = memchr(value, '=', (size_t)(cookie_end - value));
+      if(value_end == NULL)
+        value_end = cookie_end;
+      request_trim(&name, &name_end);
+      request_trim(&value, &value_end);
+      wrenSetSlotBytes(vm, 8, name, (size_t)(name_end - name));
+      wrenSetSlotBytes(vm, 9, value, (size_t)(value_end - value));
+      wrenSetMapValue(vm, slot, 8, 9);
+    }
+    cookie = cookie_end + 1;
+  }
+}
+
+// The request being run, with the body found by request_parse(). The body
+// and form fields are only decoded, and uploads only saved, when the handler
+// asks for them (see bialet_request_body and friends).
+struct CurrentRequest {
+  struct HttpMessage* hm;
+  const char*         body;
+  size_t              body_len;
+};
+
+static struct CurrentRequest current_request = {NULL, NULL, 0};
+
+// Fills slots 1 to 6 with the arguments of Request.init(): method, uri,
+// fullUri, headers, cookies (null without a Cookie header) and get, and
+// records where the body starts. Returns 0 when out of memory.
+static int request_parse(WrenVM* vm, struct HttpMessage* hm) {
+  const char* msg = hm->message.str;
+  size_t      msg_len = hm->message.len;
+  // Holds every decoded key or value in turn, and the header names while they
+  // are lowercased. Neither can be longer than the message or the URI.
+  char* scratch = malloc(msg_len + hm->uri.len + 1);
+  if(scratch == NULL)
+    return 0;
+
+  size_t method_len = hm->method.len;
+  for(size_t i = 0; i < method_len; i++)
+    scratch[i] = (char)toupper((unsigned char)hm->method.str[i]);
+  wrenSetSlotBytes(vm, 1, scratch, method_len);
+
+  const char* full_uri = hm->uri.str;
+  const char* separator = memchr(full_uri, '?', hm->uri.len);
+  wrenSetSlotBytes(vm, 3, full_uri, hm->uri.len);
+  if(separator != NULL && separator > full_uri) {
+    wrenSetSlotBytes(vm, 2, full_uri, (size_t)(separator - full_uri));
+    vm->apiStack[6] = request_query_map(
+        vm, separator + 1, hm->uri.len - (size_t)(separator + 1 - full_uri),
+        scratch);
+  } else {
+    wrenSetSlotBytes(vm, 2, full_uri, hm->uri.len);
+    wrenSetSlotNewMap(vm, 6);
+  }
+
+  wrenSetSlotNewMap(vm, 4);
+  wrenSetSlotNull(vm, 5);
+  const char* end = msg + msg_len;
+  const char* line = memchr(msg, '\n', msg_len);
+  line = line ? line + 1 : end;
+  while(line < end) {
+    const char* line_end = memchr(line, '\n', (size_t)(end - line));
+    if(line_end == NULL)
+      line_end = end;
+    const char* name = line;
+    const char* value_end = line_end;
+    request_trim(&name, &value_end);
+    if(name == value_end) {
+      // A blank line: the body follows.
+      line = line_end + 1;
+      break;
+    }
+    const char* name_end = memchr(name, ':', (size_t)(value_end - name));
+    const char* value = name_end ? name_end + 1 : value_end;
+    if(name_end == NULL)
+      name_end = value_end;
+    request_trim(&name, &name_end);
+    request_trim(&value, &value_end);
+    size_t name_len = (size_t)(name_end - name);
+    for(size_t i = 0; i < name_len; i++)
+      scratch[i] = (char)tolower((unsigned char)name[i]);
+    if(name_len == 6 && memcmp(scratch, "cookie", 6) == 0)
+      request_cookie_map(vm, 5, value, (size_t)(value_end - value));
+    wrenSetSlotBytes(vm, 8, scratch, name_len);
+    wrenSetSlotBytes(vm, 9, value, (size_t)(value_end - value));
+    wrenSetMapValue(vm, 4, 8, 9);
+    line = line_end + 1;
+  }
+  free(scratch);
+
+  current_request.hm = hm;
+  current_request.body = line < end ? line : end;
+  current_request.body_len = (size_t)(end - current_request.body);
   return 1;
 }
 
+// Request.body: the lines after the headers, joined without their "\n".
+Value bialet_request_body(WrenVM* vm) {
+  const char* line = current_request.body;
+  const char* end = line + current_request.body_len;
+  if(line == NULL)
+    return wrenNewStringLength(vm, "", 0);
+
+  char* body = malloc(current_request.body_len + 1);
+  if(body == NULL)
+    return NULL_VAL;
+  size_t body_len = 0;
+  while(line < end) {
+    const char* line_end = memchr(line, '\n', (size_t)(end - line));
+    if(line_end == NULL)
+      line_end = end;
+    memcpy(body + body_len, line, (size_t)(line_end - line));
+    body_len += (size_t)(line_end - line);
+    line = line_end + 1;
+  }
+  Value result = wrenNewStringLength(vm, body, body_len);
+  free(body);
+  return result;
+}
+
+// Request.file(): saves the upload in the form field [name] and returns its
+// id, or null when the request has none.
+Value bialet_request_upload(WrenVM* vm, ObjString* name) {
+  (void)vm;
+  if(current_request.hm == NULL)
+    return NULL_VAL;
+  sqlite3_int64 id = save_uploaded_file(current_request.hm, name->value);
+  return id > 0 ? NUM_VAL((double)id) : NULL_VAL;
+}
+
+// Request.post(): the form fields in [body], decoded as a query string.
+Value bialet_request_form(WrenVM* vm, ObjString* body) {
+  char* scratch = malloc((size_t)body->length + 1);
+  if(scratch == NULL)
+    return NULL_VAL;
+  Value form = request_query_map(vm, body->value, body->length, scratch);
+  free(scratch);
+  return form;
+}
+
+// wrenNewVM() compiles wren_core.wren and the framework (bialet.wren) before
+// any user code runs, which used to happen on every request. Requests now run
+// on a warm VM kept per process. The class statics of the core classes
+// (Request, Response, Cookie, Session, ...) are closed upvalues of their
+// methods, so their pristine values are recorded once, as (upvalue, value)
+// pairs in a list kept alive by warm_vm_statics, and written back after each
+// request. User modules, "main" included, are dropped so every request
+// compiles and runs them from scratch, as with a fresh VM.
+//
+// The warm VM also keeps the bytecode of the modules it compiled (see
+// enableModuleCache in wren.h), keyed by a hash of their source. It is
+// dropped whenever the watcher reports a change, so edited or deleted files
+// do not pin old entries. Hits and misses of VMs already recycled are added
+// up in bytecode_cache_hits/misses.
+static WrenVM*     warm_vm = NULL;
+static WrenHandle* warm_vm_statics = NULL;
+static int         warm_vm_requests = 0;
+static int         warm_vm_busy = 0;
+static long        warm_vm_generation = 0;
+static long        bytecode_cache_hits = 0;
+static long        bytecode_cache_misses = 0;
+
+// A response body used to be copied out of the VM (and trimmed, another
+// copy) before the server wrote it. Bodies from the warm VM are now lent to
+// the server as they are, kept alive by a handle, and warm_vm_lent counts
+// them until bialet_body_release(). The server may hold one until a slow
+// client reads it, so a VM recycled while some are out is kept in
+// warm_vm_retired, and freed with the last of them.
+struct RetiredVM {
+  WrenVM*           vm;
+  int               lent;
+  struct RetiredVM* next;
+};
+
+static int               warm_vm_lent = 0;
+static struct RetiredVM* warm_vm_retired = NULL;
+
+static void warm_vm_free(void) {
+  if(warm_vm == NULL)
+    return;
+  bytecode_cache_hits += warm_vm->moduleCacheHits;
+  bytecode_cache_misses += warm_vm->moduleCacheMisses;
+  if(warm_vm_statics != NULL)
+    wrenReleaseHandle(warm_vm, warm_vm_statics);
+  struct RetiredVM* retired =
+      warm_vm_lent > 0 ? malloc(sizeof(struct RetiredVM)) : NULL;
+  if(retired != NULL) {
+    retired->vm = warm_vm;
+    retired->lent = warm_vm_lent;
+    retired->next = warm_vm_retired;
+    warm_vm_retired = retired;
+  } else if(warm_vm_lent == 0) {
+    wrenFreeVM(warm_vm);
+  }
+  // Without memory to keep track of it, a VM with bodies out is leaked
+  // rather than freed under them.
+  warm_vm_lent = 0;
+  warm_vm = NULL;
+  warm_vm_statics = NULL;
+  warm_vm_requests = 0;
+}
+
+static void warm_vm_snapshot(WrenVM* vm) {
+  // Only reachable objects are left in vm->first after a collection.
+  wrenCollectGarbage(vm);
+  int count = 0;
+  for(Obj* obj = vm->first; obj != NULL; obj = obj->next) {
+    ObjUpvalue* upvalue = (ObjUpvalue*)obj;
+    if(obj->type == OBJ_UPVALUE && upvalue->value == &upvalue->closed)
+      count++;
+  }
+  ObjList* statics = wrenNewList(vm, (uint32_t)count * 2);
+  wrenPushRoot(vm, (Obj*)statics);
+  int n = 0;
+  for(Obj* obj = vm->first; obj != NULL && n < statics->elements.count; obj = obj->next) {
+    ObjUpvalue* upvalue = (ObjUpvalue*)obj;
+    if(obj->type != OBJ_UPVALUE || upvalue->value != &upvalue->closed)
+      continue;
+    statics->elements.data[n++] = OBJ_VAL(upvalue);
+    statics->elements.data[n++] = upvalue->closed;
+  }
+  statics->elements.count = n;
+  warm_vm_statics = wrenMakeHandle(vm, OBJ_VAL(statics));
+  wrenPopRoot(vm);
+}
+
+static void warm_vm_reset(WrenVM* vm) {
+  ObjList* statics = AS_LIST(warm_vm_statics->value);
+  for(int i = 0; i + 1 < statics->elements.count; i += 2) {
+    ObjUpvalue* upvalue = (ObjUpvalue*)AS_OBJ(statics->elements.data[i]);
+    upvalue->closed = statics->elements.data[i + 1];
+  }
+  // Removing a key may shrink the entry array, so restart after each one. The
+  // core module is the only one stored under null.
+  int removed = 1;
+  while(removed) {
+    removed = 0;
+    for(uint32_t i = 0; i < vm->modules->capacity; i++) {
+      Value key = vm->modules->entries[i].key;
+      if(!IS_UNDEFINED(key) && !IS_NULL(key)) {
+        wrenMapRemoveKey(vm, vm->modules, key);
+        removed = 1;
+        break;
+      }
+    }
+  }
+  vm->lastModule = NULL;
+  vm->fiber = NULL;
+}
+
+// Builds the worker's warm VM ahead of its first request.
+void bialet_warm_vm() {
+  if(warm_vm != NULL || bialet_config.arena)
+    return;
+  WrenConfiguration config = wren_config;
+  config.enableModuleCache = bialet_config.bytecode_cache != 0;
+  warm_vm = wrenNewVM(&config);
+  warm_vm_snapshot(warm_vm);
+  warm_vm_generation = server_files_generation();
+}
+
+static WrenVM* warm_vm_acquire(void) {
+  bialet_warm_vm();
+  long generation = server_files_generation();
+  if(generation != warm_vm_generation) {
+    wrenClearModuleCache(warm_vm);
+    warm_vm_generation = generation;
+  }
+  warm_vm_busy = 1;
+  return warm_vm;
+}
+
+// A VM for a single run, freed right after it. With --arena its memory comes
+// from [*arena] instead of malloc.
+static WrenVM* fresh_vm(struct Arena** arena) {
+  *arena = bialet_config.arena ? arena_new(BIALET_ARENA_LIMIT) : NULL;
+  if(*arena == NULL)
+    return wrenNewVM(&wren_config);
+  WrenConfiguration config = wren_config;
+  config.reallocateFn = arena_reallocate;
+  config.reallocateUserData = *arena;
+  config.initialHeapSize = BIALET_ARENA_LIMIT / 2;
+  return wrenNewVM(&config);
+}
+
+struct ArenaRoute {
+  char*  route;
+  long   requests;
+  size_t peak;
+  size_t total;
+};
+
+static struct ArenaRoute arena_routes[BIALET_ARENA_ROUTES + 1];
+static int               arena_route_count = 0;
+
+// Adds the high-water mark [peak] of a request to [module], the file of its
+// route.
+static void arena_record(const char* module, size_t peak) {
+  const char* root = bialet_config.full_root_dir;
+  size_t      root_len = root ? strlen(root) : 0;
+  if(root_len > 0 && strncmp(module, root, root_len) == 0 && module[root_len] == '/')
+    module += root_len;
+
+  struct ArenaRoute* entry = NULL;
+  for(int i = 0; i < arena_route_count && entry == NULL; i++) {
+    if(strcmp(arena_routes[i].route, module) == 0)
+      entry = &arena_routes[i];
+  }
+  if(entry == NULL && arena_route_count < BIALET_ARENA_ROUTES) {
+    char* route = string_safe_copy(module);
+    if(route != NULL) {
+      entry = &arena_routes[arena_route_count++];
+      entry->route = route;
+    }
+  }
+  if(entry == NULL) {
+    entry = &arena_routes[BIALET_ARENA_ROUTES];
+    entry->route = "other";
+  }
+  entry->requests++;
+  entry->total += peak;
+  if(peak > entry->peak)
+    entry->peak = peak;
+}
+
+static void format_size(char* out, size_t size, size_t bytes) {
+  if(bytes >= 1024 * 1024)
+    snprintf(out, size, "%.1f MB", (double)bytes / (1024 * 1024));
+  else
+    snprintf(out, size, "%.1f KB", (double)bytes / 1024);
+}
+
+static void report_arena_route(struct ArenaRoute* entry) {
+  if(entry->requests == 0)
+    return;
+  char peak[32];
+  char average[32];
+  format_size(peak, sizeof(peak), entry->peak);
+  format_size(average, sizeof(average), entry->total / (size_t)entry->requests);
+  message(yellow("Arena"), entry->route, "peak", peak, "average", average);
+}
+
+// Logs the bytecode cache counters of this process, when it has served any
+// request, and the arena high-water mark of each route with --arena.
+static void report_cache(char* name, long hits, long misses) {
+  if(hits + misses == 0)
+    return;
+  char hits_str[24];
+  char misses_str[24];
+  char rate_str[24];
+  snprintf(hits_str, sizeof(hits_str), "%ld", hits);
+  snprintf(misses_str, sizeof(misses_str), "%ld", misses);
+  snprintf(rate_str, sizeof(rate_str), "%.1f%%", 100.0 * (double)hits / (double)(hits + misses));
+  message(yellow(name), "hits", hits_str, "misses", misses_str, "hit rate", rate_str);
+}
+
+void bialet_report_stats() {
+  for(int i = 0; i <= BIALET_ARENA_ROUTES; i++) {
+    if(i < arena_route_count || i == BIALET_ARENA_ROUTES)
+      report_arena_route(&arena_routes[i]);
+  }
+
+  report_cache("Bytecode cache",
+               bytecode_cache_hits + (warm_vm ? warm_vm->moduleCacheHits : 0),
+               bytecode_cache_misses + (warm_vm ? warm_vm->moduleCacheMisses : 0));
+  report_cache("Statement cache", stmt_cache_hits, stmt_cache_misses);
+  long hits, misses, invalidations;
+  query_cache_stats(&hits, &misses, &invalidations);
+  report_cache("Query cache", hits, misses);
+  if(invalidations > 0) {
+    char invalidations_str[24];
+    snprintf(invalidations_str, sizeof(invalidations_str), "%ld", invalidations);
+    message(yellow("Query cache"), "invalidations", invalidations_str);
+  }
+}
+
+static void warm_vm_release(int error) {
+  warm_vm_busy = 0;
+  if(error || ++warm_vm_requests >= BIALET_WARM_VM_MAX_REQUESTS)
+    warm_vm_free();
+  else
+    warm_vm_reset(warm_vm);
+}
+
+void bialet_body_release(WrenVM* vm, WrenHandle* body_ref) {
+  if(body_ref == NULL)
+    return;
+  wrenReleaseHandle(vm, body_ref);
+  if(vm == warm_vm) {
+    warm_vm_lent--;
+    return;
+  }
+  for(struct RetiredVM** at = &warm_vm_retired; *at != NULL; at = &(*at)->next) {
+    struct RetiredVM* retired = *at;
+    if(retired->vm != vm)
+      continue;
+    if(--retired->lent == 0) {
+      *at = retired->next;
+      wrenFreeVM(retired->vm);
+      free(retired);
+    }
+    return;
+  }
+}
+
+void bialet_response_release(struct BialetResponse* response) {
+  bialet_body_release(response->body_vm, response->body_ref);
+  response->body_ref = NULL;
+  response->body_vm = NULL;
+}
+
+// The bytes of the string in slot 0, or of the StringBuilder that
+// Response.out_ hands over, so the page is never copied into a string.
+static const char* response_slot_bytes(WrenVM* vm, int* length) {
+  Value value = vm->apiStack[0];
+  if(IS_STRING_BUILDER(value)) {
+    ObjStringBuilder* builder = AS_STRING_BUILDER(value);
+    *length = (int)builder->length;
+    return builder->value != NULL ? builder->value : "";
+  }
+  return wrenGetSlotBytes(vm, 0, length);
+}
+
+// Sets the body of [r] to the string or builder in slot 0, trimmed like
+// String.trim() when [trim] is set. With [lend] the body points into the
+// string or builder itself, which the handle keeps alive.
+static void response_take_body(WrenVM* vm, struct BialetResponse* r, int trim,
+                               int lend) {
+  int         length = 0;
+  const char* body = response_slot_bytes(vm, &length);
+  const char* end = body + length;
+  if(trim)
+    request_trim(&body, &end);
+  size_t body_len = (size_t)(end - body);
+  if(lend && body_len > 0) {
+    r->body = (char*)body;
+    r->body_ref = wrenGetSlotHandle(vm, 0);
+    r->body_vm = vm;
+    r->body_owned = 0;
+    r->length = body_len;
+    warm_vm_lent++;
+    return;
+  }
+  r->body = malloc(body_len + 1);
+  if(r->body == NULL) {
+    r->body_owned = 0;
+    r->length = 0;
+    return;
+  }
+  memcpy(r->body, body, body_len);
+  r->body[body_len] = '\0';
+  r->body_owned = 1;
+  r->length = body_len;
+}
+
+// Db.transaction commits or rolls back before it returns, but a transaction
+// begun with a plain BEGIN, or one whose fiber never finished, would otherwise
+// stay open into the next run on this connection.
+static void rollback_open_transaction(void) {
+  if(db == NULL || sqlite3_get_autocommit(db))
+    return;
+  message(red("SQL Error"), "Transaction left open, rolling it back");
+  sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+}
+
 struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* hm) {
   struct BialetResponse r;
   r.status = HTTP_OK;
@@ -877,30 +1594,40 @@ struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* h
   r.length = 0;
   r.body_owned = 0;
   r.header_owned = 0;
+  r.file_id = 0;
+  r.body_ref = NULL;
+  r.body_vm = NULL;
   int     error = 0;
   WrenVM* vm = 0;
 
   show_errors_clear();
 
-  vm = wrenNewVM(&wren_config);
+  // A request started from inside another one (Test.request) gets its own.
+  struct CurrentRequest outer_request = current_request;
+  current_request.hm = NULL;
+  current_request.body = NULL;
+  current_request.body_len = 0;
+
+  // Background runs (cron, migrations, -r) keep a fresh VM of their own, and so
+  // does a request started from inside one (Test.request in -T mode).
+  int           warm = hm != NULL && !warm_vm_busy && !bialet_config.arena;
+  struct Arena* arena = NULL;
+  vm = warm ? warm_vm_acquire() : fresh_vm(&arena);
   wrenSetUserData(vm, module);
   wrenInterpret(vm, MAIN_MODULE_NAME, MAIN_MODULE_SOURCE);
   if(hm) {
     /* Initialize request */
-    wrenEnsureSlots(vm, 4);
+    wrenEnsureSlots(vm, 10);
     wrenGetVariable(vm, MAIN_MODULE_NAME, "Request", 0);
     WrenHandle* requestClass = wrenGetSlotHandle(vm, 0);
-    WrenHandle* initMethod = wrenMakeCallHandle(vm, "init(_,_,_)");
+    WrenHandle* initMethod = wrenMakeCallHandle(vm, "init(_,_,_,_,_,_,_)");
     wrenSetSlotHandle(vm, 0, requestClass);
-    wrenSetSlotString(vm, 1, hm->message.str);
-    wrenSetSlotString(vm, 2, hm->routes.str);
-
-    char filesIds[MAX_URL_LEN] = "";
-    // Save uploaded files with size validation (max_upload_size config)
-    save_uploaded_files(hm, filesIds);
-    wrenSetSlotString(vm, 3, filesIds);
+    wrenSetSlotString(vm, 7, hm->routes.str);
 
-    if((error = wrenCall(vm, initMethod) != WREN_RESULT_SUCCESS))
+    if(!request_parse(vm, hm)) {
+      message(red("Runtime Error"), "Out of memory while parsing the request");
+      error = 1;
+    } else if((error = wrenCall(vm, initMethod) != WREN_RESULT_SUCCESS))
       message(red("Runtime Error"), "Failed to initialize request");
     wrenReleaseHandle(vm, requestClass);
     wrenReleaseHandle(vm, initMethod);
@@ -914,9 +1641,10 @@ struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* h
     wrenEnsureSlots(vm, 2);
     int type = wrenGetSlotType(vm, 0);
     if(type == WREN_TYPE_STRING) {
-      const char* returnBody = wrenGetSlotString(vm, 0);
-      r.body = string_safe_copy(returnBody);
-      r.body_owned = 1;
+      int length = 0;
+      wrenGetSlotBytes(vm, 0, &length);
+      if(length > 0)
+        response_take_body(vm, &r, 0, warm);
     } else if(IS_INSTANCE(vm->apiStack[0])) {
       /* A handler may return an HtmlNode: an HTML literal already rendered by
        * the template escape machinery. Stringify it so the page is served. */
@@ -924,58 +1652,57 @@ struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* h
       if(AS_INSTANCE(vm->apiStack[0])->obj.classObj == AS_CLASS(vm->apiStack[1])) {
         WrenHandle* toString = wrenMakeCallHandle(vm, "toString");
         wrenSetSlotHandle(vm, 0, wrenGetSlotHandle(vm, 0));
-        if(wrenCall(vm, toString) == WREN_RESULT_SUCCESS) {
-          const char* body = wrenGetSlotString(vm, 0);
-          r.body = string_safe_copy(body);
-          r.body_owned = 1;
-        }
+        if(wrenCall(vm, toString) == WREN_RESULT_SUCCESS &&
+           wrenGetSlotType(vm, 0) == WREN_TYPE_STRING)
+          response_take_body(vm, &r, 0, warm);
       }
     }
 
     wrenGetVariable(vm, module, "Response", 0);
     WrenHandle* responseClass = wrenGetSlotHandle(vm, 0);
-    if(r.body == NULL || strlen(r.body) == 0) {
+    if(r.body == NULL || r.length == 0) {
       /* Get body from response */
-      WrenHandle* outMethod = wrenMakeCallHandle(vm, "out");
+      if(r.body_owned)
+        free(r.body);
+      r.body = NULL;
+      r.body_owned = 0;
+      WrenHandle* outMethod = wrenMakeCallHandle(vm, "out_");
       wrenSetSlotHandle(vm, 0, responseClass);
       if((error = wrenCall(vm, outMethod) != WREN_RESULT_SUCCESS)) {
         message(red("Runtime Error"), "Failed to get body");
-      } else if(wrenGetSlotType(vm, 0) != WREN_TYPE_STRING) {
+      } else if(wrenGetSlotType(vm, 0) != WREN_TYPE_STRING &&
+                !IS_STRING_BUILDER(vm->apiStack[0])) {
         /* wrenGetSlotString only asserts the slot type, and asserts compile out
          * with NDEBUG -- so a handler returning a non-string from Response.out
          * reinterpreted whatever was in the slot as a char*. */
         message(red("Runtime Error"), "Response body is not a string");
         error = 1;
       } else {
-        const char* body = wrenGetSlotString(vm, 0);
-        if(body[0] != BIALET_FILE_CHAR) {
-          r.body = string_safe_copy(body);
-          r.body_owned = 1;
+        int         length = 0;
+        const char* body = response_slot_bytes(vm, &length);
+        const char* end = body + length;
+        request_trim(&body, &end);
+        if(body == end || body[0] != BIALET_FILE_CHAR) {
+          response_take_body(vm, &r, 1, warm);
         } else {
           /* Handle BIALET_FILE_CHAR response for file serving.
-           * This retrieves file content from the database when the response body
-           * starts with BIALET_FILE_CHAR. Consider moving this logic to the server
-           * layer in the future to better separate concerns between the Wren runtime
-           * and response preparation. */
-          sqlite3_stmt* stmt;
-          int           result = sqlite3_prepare_v2(
-              db, "SELECT file FROM BIALET_FILES WHERE id = ?", -1, &stmt, 0);
-          if(!(error = result != SQLITE_OK)) {
-            sqlite3_bind_text(stmt, 1, body + 1, -1, SQLITE_STATIC);
-            if(sqlite3_step(stmt) == SQLITE_ROW) {
-              int len = 0;
-              len = sqlite3_column_bytes(stmt, 0);
-              r.body = safe_malloc(len + 1);
-              memcpy(r.body, sqlite3_column_blob(stmt, 0), len);
-              r.length = len;
-              r.body_owned = 1;
-            } else {
-              // If the id is not found, we will send an internal server error.
-              message(red("Error file not found"), sqlite3_errmsg(db));
-              error = 1;
-            }
-            sqlite3_finalize(stmt);
+           * Only the size is read here: the server streams the blob itself
+           * (see bialet_read_blob), so a large upload is never loaded whole
+           * into the worker, and a Range request reads only its slice. */
+          char*         id_end = NULL;
+          long long     file_id = strtoll(body + 1, &id_end, 10);
+          sqlite3_blob* blob = NULL;
+          if(id_end != body + 1 && id_end == end &&
+             sqlite3_blob_open(db, "main", "BIALET_FILES", "file", file_id, 0, &blob) ==
+                 SQLITE_OK) {
+            r.file_id = file_id;
+            r.length = (size_t)sqlite3_blob_bytes(blob);
+          } else {
+            // If the id is not found, we will send an internal server error.
+            message(red("Error file not found"), sqlite3_errmsg(db));
+            error = 1;
           }
+          sqlite3_blob_close(blob);
         }
       }
       wrenReleaseHandle(vm, outMethod);
@@ -1030,12 +1757,33 @@ struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* h
     /* Clean Wren vm */
     wrenReleaseHandle(vm, responseClass);
   }
-  wrenFreeVM(vm);
+  // Cursors left open by a loop that was cut short or aborted hold statements
+  // from the cache, which only the request can give back.
+  wrenCloseCursors(vm);
+  rollback_open_transaction();
+  if(warm) {
+    warm_vm_release(error);
+  } else if(arena != NULL) {
+    // Nothing in a bialet VM holds resources besides its memory (there are no
+    // foreign classes), so the arena is dropped whole rather than walking every
+    // object to free it.
+    if(hm != NULL)
+      arena_record(module, arena_peak(arena));
+    arena_free(arena);
+  } else {
+    wrenFreeVM(vm);
+  }
 
   if(error) {
+    r.file_id = 0;
     if(hm != NULL && show_errors_enabled()) {
       char* page = show_errors_page();
       if(page != NULL) {
+        bialet_response_release(&r);
+        if(r.body_owned)
+          free(r.body);
+        if(r.header_owned)
+          free(r.header);
         r.status = HTTP_ERROR;
         r.body = page;
         r.body_owned = 1;
@@ -1055,9 +1803,25 @@ struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* h
     r.header_owned = 0;
   }
 
+  current_request = outer_request;
   return r;
 }
 
+// Reads [length] bytes of the BIALET_FILES blob [file_id], starting at
+// [offset], into [buffer]. The server reads a download one chunk at a time, as
+// the client takes it, and each chunk opens its own blob handle, so the read
+// transaction is not held while the client drains a slow download; without
+// WAL that would lock every writer out for the whole transfer. Returns 1 when
+// every byte was read.
+int bialet_read_blob(long long file_id, size_t offset, char* buffer, size_t length) {
+  sqlite3_blob* blob = NULL;
+  int rc = sqlite3_blob_open(db, "main", "BIALET_FILES", "file", file_id, 0, &blob);
+  if(rc == SQLITE_OK)
+    rc = sqlite3_blob_read(blob, buffer, (int)length, (int)offset);
+  sqlite3_blob_close(blob);
+  return rc == SQLITE_OK;
+}
+
 int bialet_run_cli(char* code) {
   struct BialetResponse response = bialet_run(CLI_MODULE_NAME, code, NULL);
   int                   status = response.status == HTTP_ERROR ? 1 : 0;
@@ -1110,6 +1874,7 @@ int bialet_validate_syntax(const char* filePath) {
   wrenInterpret(vm, MAIN_MODULE_NAME, MAIN_MODULE_SOURCE);
   WrenInterpretResult result = wrenInterpret(vm, abs_path, code);
   wrenFreeVM(vm);
+  rollback_open_transaction();
   free(code);
 
   if(result == WREN_RESULT_COMPILE_ERROR) {
@@ -1213,6 +1978,7 @@ static TestResult run_test_file(const char* testPath, const char* initPath,
   test_capture_end();
 
   wrenFreeVM(vm);
+  rollback_open_transaction();
   free(code);
 
   if(skipped)
@@ -1519,12 +2285,13 @@ void bialet_init(struct BialetConfig* config) {
     message(red("SQL Error"), "Can't open database in", config->db_path);
     exit(BIALET_SQLITE_ERROR);
   }
+  sqlite3_set_authorizer(db, stmt_authorize, NULL);
+  sqlite3_update_hook(db, query_cache_update, NULL);
   apply_sqlite_pragmas();
 
   wrenInitConfiguration(&wren_config);
   wren_config.writeFn = &bialet_wren_write;
   wren_config.errorFn = &bialet_wren_error;
-  wren_config.queryFn = &query_execute;
   wren_config.loadModuleFn = &bialet_wren_load_module;
   wren_config.enableTests = config->enable_tests;
 
@@ -1533,6 +2300,9 @@ void bialet_init(struct BialetConfig* config) {
 
 void bialet_cleanup() {
   if(db) {
+    stmt_cache_clear();
+    query_cache_clear();
+    schema_stmt = NULL;
     // sqlite3_close() fails with SQLITE_BUSY when any statement is still
     // unfinalized and then leaves the handle open; its return was discarded, so
     // the connection just leaked. sqlite3_close_v2() marks the handle as a
@@ -1551,6 +2321,9 @@ void bialet_cleanup() {
 // SQLite forbids.
 void bialet_reopen_db() {
   if(db) {
+    stmt_cache_clear();
+    query_cache_clear();
+    schema_stmt = NULL;
     sqlite3_close_v2(db);
     db = NULL;
   }
@@ -1560,118 +2333,7 @@ void bialet_reopen_db() {
     message(red("SQL Error"), "Can't reopen database after fork");
     exit(BIALET_SQLITE_ERROR);
   }
+  sqlite3_set_authorizer(db, stmt_authorize, NULL);
+  sqlite3_update_hook(db, query_cache_update, NULL);
   apply_sqlite_pragmas();
 }
-
-BialetQuery* create_bialet_query() {
-  BialetQuery* query = (BialetQuery*)malloc(sizeof(BialetQuery));
-  if(query == NULL)
-    return NULL;
-  query->results = NULL;
-  query->resultsCount = 0;
-  query->parameters = NULL;
-  query->parametersCount = 0;
-  query->queryString = NULL;
-  query->lastInsertId = NULL;
-  return query;
-}
-
-int add_result(BialetQuery* query) {
-  int                count = query->resultsCount + 1;
-  BialetQueryResult* new_results = (BialetQueryResult*)realloc(
-      query->results, (size_t)count * sizeof(BialetQueryResult));
-  if(new_results == NULL)
-    return -1;
-  query->results = new_results;
-  query->resultsCount = count;
-  BialetQueryResult* newResult = &query->results[count - 1];
-  newResult->rows = NULL;
-  newResult->rowCount = 0;
-  return 0;
-}
-
-int add_result_row(BialetQuery* query, int resultIndex, const char* name,
-                   const char* value, int size, BialetQueryType type) {
-  if(resultIndex < 0 || resultIndex >= query->resultsCount)
-    return -1;
-
-  BialetQueryResult* result = &query->results[resultIndex];
-  int                count = result->rowCount + 1;
-  BialetQueryRow*    new_rows =
-      (BialetQueryRow*)realloc(result->rows, (size_t)count * sizeof(BialetQueryRow));
-  if(new_rows == NULL)
-    return -1;
-  result->rows = new_rows;
-  result->rowCount = count;
-  BialetQueryRow* newRow = &result->rows[count - 1];
-  newRow->name = string_safe_copy(name != NULL ? name : "");
-  if(value != NULL && size > 0) {
-    newRow->value = safe_malloc((size_t)size);
-    memcpy(newRow->value, value, size);
-  } else {
-    newRow->value = string_safe_copy("");
-  }
-  newRow->size = size;
-  newRow->type = type;
-  return 0;
-}
-
-int add_parameter(BialetQuery* query, const char* value, BialetQueryType type) {
-  char* copy = value != NULL ? strdup(value) : NULL;
-  if(value != NULL && copy == NULL)
-    return -1;
-  int                   count = query->parametersCount + 1;
-  BialetQueryParameter* new_parameters = (BialetQueryParameter*)realloc(
-      query->parameters, (size_t)count * sizeof(BialetQueryParameter));
-  if(new_parameters == NULL) {
-    free(copy);
-    return -1;
-  }
-  query->parameters = new_parameters;
-  query->parametersCount = count;
-  BialetQueryParameter* newParameter = &query->parameters[count - 1];
-  newParameter->value = copy;
-  newParameter->type = type;
-  return 0;
-}
-
-void free_bialet_query(BialetQuery* query) {
-  if(!query)
-    return; // Guard clause to prevent dereferencing a NULL pointer
-
-  // Free each row in each result
-  for(int i = 0; i < query->resultsCount; i++) {
-    for(int j = 0; j < query->results[i].rowCount; j++) {
-      free(query->results[i].rows[j].name); // Free row name
-      query->results[i].rows[j].name = NULL;
-
-      free(query->results[i].rows[j].value); // Free row value
-      query->results[i].rows[j].value = NULL;
-    }
-    free(query->results[i].rows); // Free the rows array itself
-    query->results[i].rows = NULL;
-  }
-  free(query->results); // Free the results array
-  query->results = NULL;
-
-  // Free each parameter value
-  for(int i = 0; i < query->parametersCount; i++) {
-    free(query->parameters[i].value);
-    query->parameters[i].value = NULL;
-  }
-  free(query->parameters); // Free the parameters array
-  query->parameters = NULL;
-
-  // Free queryString and lastInsertId if they exist
-  if(query->queryString) {
-    free(query->queryString);
-    query->queryString = NULL;
-  }
-  if(query->lastInsertId) {
-    free(query->lastInsertId);
-    query->lastInsertId = NULL;
-  }
-
-  // Finally, free the BialetQuery structure itself
-  free(query);
-}
@@ -13,15 +13,31 @@
 
 #include "bialet.h"
 #include "server.h"
+#include <sqlite3.h>
 
 void bialet_init(struct BialetConfig* config);
 void bialet_cleanup();
 void bialet_reopen_db();
 void bialet_enable_dev_flags();
+void bialet_warm_vm();
+void bialet_report_stats();
 
 const char* bialet_get_full_root_dir();
 
 struct BialetResponse bialet_run(char* module, char* code, struct HttpMessage* hm);
+void bialet_response_release(struct BialetResponse* response);
+void bialet_body_release(struct WrenVM* vm, struct WrenHandle* body_ref);
+int bialet_read_blob(long long file_id, size_t offset, char* buffer, size_t length);
+
+/* Queries run from Wren share the statement cache. Prepare returns NULL, after
+ * logging the error, for a query that does not compile and for a blank one.
+ * Release takes the result of the last sqlite3_step() and logs it when it was
+ * an error. */
+sqlite3_stmt* bialet_query_prepare(const char* sql);
+void          bialet_query_release(sqlite3_stmt* stmt, int result);
+/* The tables [stmt] reads, each followed by a newline, or NULL when it is not
+ * in the statement cache or they are not known. */
+const char* bialet_query_reads(sqlite3_stmt* stmt);
 
 char* read_file(const char* path);
 char* bialet_read_file(const char* path);
@@ -31,5 +47,6 @@ int bialet_validate_syntax(const char* filePath);
 int bialet_run_tests(const char* testDir, const char* rootDir);
 
 #define BIALET_INDEX_FILE "/index" BIALET_EXTENSION
+#define BIALET_FILE_CHUNK_SIZE (32 * 1024)
 
 #endif
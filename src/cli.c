@@ -38,6 +38,14 @@ typedef enum {
   CLI_OPT_CPU_HARD,
   CLI_OPT_MAX_POST,
   CLI_OPT_QUIET,
+  CLI_OPT_WORKERS,
+  CLI_OPT_SOCKET,
+  CLI_OPT_BACKLOG,
+  CLI_OPT_TCP_NODELAY,
+  CLI_OPT_TCP_DEFER_ACCEPT,
+  CLI_OPT_TCP_FASTOPEN,
+  CLI_OPT_NO_BYTECODE_CACHE,
+  CLI_OPT_ARENA,
   CLI_OPT_COUNT
 } CliOptId;
 
@@ -53,7 +61,10 @@ static const CliOptSpec cli_opts[] = {
     {"version", 'v', 0},  {"log", 'l', 1},      {"db", 'd', 1},
     {"wal", 'w', 0},      {"ignore", 'i', 1},   {"mem-soft", 'm', 1},
     {"mem-hard", 'M', 1}, {"cpu-soft", 'c', 1}, {"cpu-hard", 'C', 1},
-    {"max-post", 'b', 1}, {"quiet", 'q', 0},
+    {"max-post", 'b', 1}, {"quiet", 'q', 0},    {"workers", 'W', 1},
+    {"socket", 's', 1},   {"backlog", 'B', 1},  {"tcp-nodelay", 'n', 0},
+    {"tcp-defer-accept", 'D', 0},               {"tcp-fastopen", 'F', 1},
+    {"no-bytecode-cache", 'O', 0},             {"arena", 'A', 0},
 };
 
 /* cli_opts[] is indexed by CliOptId, so the two must stay the same length and
@@ -180,6 +191,50 @@ static void set_option(CliOptId id, const char* value, struct BialetConfig* conf
       config->quiet = 1;
       config->output_color = 0;
       break;
+    case CLI_OPT_WORKERS:
+      num = strtol(value, &endptr, 10);
+      if(*endptr != '\0' || num < 1 || num > BIALET_MAX_WORKERS) {
+        cli_error(opts, "Invalid number of workers: %s (use 1 to %d)", value,
+                  BIALET_MAX_WORKERS);
+        return;
+      }
+      config->workers = (int)num;
+      break;
+    case CLI_OPT_SOCKET:
+      if(*value == '\0') {
+        cli_error(opts, "Invalid socket path: %s", value);
+        return;
+      }
+      config->socket_path = (char*)value;
+      break;
+    case CLI_OPT_BACKLOG:
+      num = strtol(value, &endptr, 10);
+      if(*endptr != '\0' || num < 1 || num > 65535) {
+        cli_error(opts, "Invalid backlog: %s (use 1 to 65535)", value);
+        return;
+      }
+      config->backlog = (int)num;
+      break;
+    case CLI_OPT_TCP_NODELAY:
+      config->tcp_nodelay = 1;
+      break;
+    case CLI_OPT_TCP_DEFER_ACCEPT:
+      config->tcp_defer_accept = 1;
+      break;
+    case CLI_OPT_TCP_FASTOPEN:
+      num = strtol(value, &endptr, 10);
+      if(*endptr != '\0' || num < 0 || num > 65535) {
+        cli_error(opts, "Invalid TCP Fast Open queue length: %s", value);
+        return;
+      }
+      config->tcp_fastopen = (int)num;
+      break;
+    case CLI_OPT_NO_BYTECODE_CACHE:
+      config->bytecode_cache = 0;
+      break;
+    case CLI_OPT_ARENA:
+      config->arena = 1;
+      break;
     case CLI_OPT_COUNT:
       break;
   }
@@ -83,6 +83,21 @@ void cli_print_version(void);
   "30)\n"                                                                           \
   "  -b, --max-post KB     Max request body                       (default: "       \
   "128)\n"                                                                          \
+  "  -W, --workers N       HTTP worker processes                  (default: "       \
+  "1)\n"                                                                            \
+  "  -s, --socket PATH     Listen on a Unix domain socket instead of host:port\n"   \
+  "  -B, --backlog N       Pending connection queue for listen()  (default: "       \
+  "511)\n"                                                                          \
+  "  -n, --tcp-nodelay     Disable Nagle's algorithm (TCP_NODELAY)\n"               \
+  "  -D, --tcp-defer-accept\n"                                                      \
+  "                        Wake up only when request data arrives "                 \
+  "(Linux)\n"                                                                       \
+  "  -F, --tcp-fastopen N  TCP Fast Open queue length, 0 disables (default: "       \
+  "0)\n"                                                                            \
+  "  -O, --no-bytecode-cache\n"                                                     \
+  "                        Compile every module on every request\n"                 \
+  "  -A, --arena           Run each request on a fresh VM allocated from an "       \
+  "arena\n"                                                                         \
   "  -q, --quiet           Quiet: suppress the browser auto-open and colored "      \
   "output\n\n"                                                                      \
   "Long options take a value as `--port 8080` or `--port=8080`.\n\n"                \
@@ -4,6 +4,7 @@
 #include <errno.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -375,3 +376,172 @@ bool prim_json_parse_primitive(WrenVM* vm, Value* args) {
   args[0] = result;
   return true;
 }
+
+// Json.stringify used to be JsonStringifier in bialet.wren, which built every
+// string, list and map as its own Wren string and joined them, copying each
+// value once per level it was nested in. This writes the whole document into
+// one growable buffer instead.
+
+typedef struct {
+  char*  data;
+  size_t length;
+  size_t capacity;
+  bool   failed;
+} JsonBuffer;
+
+// The value has no JSON form here (a class instance, a Range, an HtmlNode...),
+// and Json.stringify falls back to JsonStringifier.
+#define JSON_UNSUPPORTED 1
+#define JSON_TOO_DEEP 2
+
+static void buffer_write(JsonBuffer* buffer, const char* data, size_t length) {
+  if(buffer->failed || length == 0)
+    return;
+  if(buffer->length + length > buffer->capacity) {
+    size_t capacity = buffer->capacity < 256 ? 256 : buffer->capacity;
+    while(capacity < buffer->length + length)
+      capacity *= 2;
+    char* grown = realloc(buffer->data, capacity);
+    if(grown == NULL) {
+      buffer->failed = true;
+      return;
+    }
+    buffer->data = grown;
+    buffer->capacity = capacity;
+  }
+  memcpy(buffer->data + buffer->length, data, length);
+  buffer->length += length;
+}
+
+static void buffer_char(JsonBuffer* buffer, char c) {
+  buffer_write(buffer, &c, 1);
+}
+
+static void stringify_string(JsonBuffer* buffer, const char* s, size_t length) {
+  buffer_char(buffer, '"');
+  size_t run = 0;
+  for(size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)s[i];
+    if(c >= 0x20 && c != '"' && c != '\\')
+      continue;
+
+    buffer_write(buffer, s + run, i - run);
+    run = i + 1;
+    switch(c) {
+      case '"': buffer_write(buffer, "\\\"", 2); break;
+      case '\\': buffer_write(buffer, "\\\\", 2); break;
+      case '\b': buffer_write(buffer, "\\b", 2); break;
+      case '\f': buffer_write(buffer, "\\f", 2); break;
+      case '\n': buffer_write(buffer, "\\n", 2); break;
+      case '\r': buffer_write(buffer, "\\r", 2); break;
+      case '\t': buffer_write(buffer, "\\t", 2); break;
+      default: {
+        char escape[7];
+        snprintf(escape, sizeof(escape), "\\u%04X", c);
+        buffer_write(buffer, escape, 6);
+      }
+    }
+  }
+  buffer_write(buffer, s + run, length - run);
+  buffer_char(buffer, '"');
+}
+
+// Numbers are written like Num.toString, except NaN and the infinities, which
+// JSON has no literal for and are written as null.
+static void stringify_number(JsonBuffer* buffer, double value) {
+  if(isnan(value) || isinf(value)) {
+    buffer_write(buffer, "null", 4);
+    return;
+  }
+  char number[24];
+  int  length = snprintf(number, sizeof(number), "%.14g", value);
+  buffer_write(buffer, number, (size_t)length);
+}
+
+static int stringify_value(JsonBuffer* buffer, Value value, int depth);
+
+// Object keys have to be strings, so other keys are written as the string
+// their toString gives.
+static int stringify_key(JsonBuffer* buffer, Value key) {
+  if(IS_STRING(key)) {
+    stringify_string(buffer, AS_CSTRING(key), AS_STRING(key)->length);
+  } else if(IS_NUM(key) && !isnan(AS_NUM(key)) && !isinf(AS_NUM(key))) {
+    char number[24];
+    int  length = snprintf(number, sizeof(number), "%.14g", AS_NUM(key));
+    stringify_string(buffer, number, (size_t)length);
+  } else if(IS_BOOL(key)) {
+    stringify_string(buffer, AS_BOOL(key) ? "true" : "false", AS_BOOL(key) ? 4 : 5);
+  } else if(IS_NULL(key)) {
+    stringify_string(buffer, "null", 4);
+  } else {
+    return JSON_UNSUPPORTED;
+  }
+  return 0;
+}
+
+static int stringify_value(JsonBuffer* buffer, Value value, int depth) {
+  if(depth > MAX_JSON_DEPTH)
+    return JSON_TOO_DEEP;
+
+  if(IS_NULL(value)) {
+    buffer_write(buffer, "null", 4);
+  } else if(IS_BOOL(value)) {
+    buffer_write(buffer, AS_BOOL(value) ? "true" : "false", AS_BOOL(value) ? 4 : 5);
+  } else if(IS_NUM(value)) {
+    stringify_number(buffer, AS_NUM(value));
+  } else if(IS_STRING(value)) {
+    stringify_string(buffer, AS_CSTRING(value), AS_STRING(value)->length);
+  } else if(IS_LIST(value)) {
+    ObjList* list = AS_LIST(value);
+    buffer_char(buffer, '[');
+    for(int i = 0; i < list->elements.count; i++) {
+      if(i > 0)
+        buffer_char(buffer, ',');
+      int error = stringify_value(buffer, list->elements.data[i], depth + 1);
+      if(error != 0)
+        return error;
+    }
+    buffer_char(buffer, ']');
+  } else if(IS_MAP(value)) {
+    ObjMap* map = AS_MAP(value);
+    bool    first = true;
+    buffer_char(buffer, '{');
+    for(uint32_t i = 0; i < map->capacity; i++) {
+      MapEntry* entry = &map->entries[i];
+      if(IS_UNDEFINED(entry->key))
+        continue;
+      if(!first)
+        buffer_char(buffer, ',');
+      first = false;
+      int error = stringify_key(buffer, entry->key);
+      if(error != 0)
+        return error;
+      buffer_char(buffer, ':');
+      error = stringify_value(buffer, entry->value, depth + 1);
+      if(error != 0)
+        return error;
+    }
+    buffer_char(buffer, '}');
+  } else {
+    return JSON_UNSUPPORTED;
+  }
+  return 0;
+}
+
+bool prim_json_stringify_primitive(WrenVM* vm, Value* args) {
+  // Nothing below allocates on the Wren heap until the result string, so the
+  // collector can not run while the maps and lists are being walked.
+  JsonBuffer buffer = {NULL, 0, 0, false};
+  int        error = stringify_value(&buffer, args[1], 0);
+  if(error != 0 || buffer.failed) {
+    free(buffer.data);
+    if(error == JSON_UNSUPPORTED)
+      RETURN_NULL;
+    if(error == JSON_TOO_DEEP)
+      RETURN_ERROR("Json nesting is too deep (or it contains itself).");
+    RETURN_ERROR("Out of memory writing JSON.");
+  }
+  Value result = wrenNewStringLength(vm, buffer.data, buffer.length);
+  free(buffer.data);
+  RETURN_VAL(result);
+}
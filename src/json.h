@@ -6,4 +6,8 @@
 
 bool prim_json_parse_primitive(WrenVM* vm, Value* args);
 
+// Returns null when the value holds something other than null, bools, numbers,
+// strings, lists and maps, for Json.stringify to handle in Wren.
+bool prim_json_stringify_primitive(WrenVM* vm, Value* args);
+
 #endif
@@ -129,6 +129,9 @@ static const char* find_bytes(const char* haystack, size_t haystack_len,
 int livereload_inject_response(struct BialetResponse* response) {
   if(!enabled)
     return 0;
+  // A Response.file() body is streamed from the database, never injected.
+  if(response->file_id)
+    return 0;
   if(response->header == NULL)
     return 0;
   if(strstr(response->header, "text/html") == NULL)
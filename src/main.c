@@ -68,6 +68,16 @@
 #define IGNORED_FILES "README*,AGENTS*,LICENSE*,*.json,*.yml,*.yaml,*.exe"
 #define WAIT_FOR_RELOAD 3
 #define SERVER_POLL_DELAY 200
+// A worker that dies this soon after it was started is failing to start, not
+// crashing on a request. It is restarted after a growing delay, and given up
+// on after a few attempts in a row.
+#define WORKER_QUICK_EXIT_MS 1000
+#define WORKER_RESTART_DELAY_MS 100
+#define WORKER_RESTART_MAX_DELAY_MS 5000
+#define WORKER_MAX_QUICK_EXITS 10
+// How often the supervisor looks for dead workers while another one waits to
+// be restarted.
+#define WORKER_REAP_POLL_MS 50
 
 struct BialetConfig bialet_config;
 /* Written only by trigger_reload_files: once from main() before any thread
@@ -77,11 +87,18 @@ static time_t last_reload = 0;
 // sig_atomic_t is the only integer type the standard guarantees can be written
 // by a signal handler and read by the main flow without tearing.
 static volatile sig_atomic_t keep_running = 1;
-// PID of the HTTP child, so the shutdown signal can be forwarded to it. Killing
-// only the supervisor left the child holding the listening socket and serving
-// forever, which `kill -TERM <pid>` reproduces (an interactive Ctrl-C hid it,
-// because the terminal signals the whole process group).
-static volatile sig_atomic_t http_child_pid = 0;
+// PIDs of the HTTP workers, so the shutdown signal can be forwarded to them.
+// Killing only the supervisor left the child holding the listening socket and
+// serving forever, which `kill -TERM <pid>` reproduces (an interactive Ctrl-C
+// hid it, because the terminal signals the whole process group). A slot is 0
+// while its worker is not running.
+static volatile sig_atomic_t http_worker_pids[BIALET_MAX_WORKERS];
+// When each worker was started, and how many times in a row it died right away.
+static struct timespec       http_worker_started[BIALET_MAX_WORKERS];
+static int                   http_worker_quick_exits[BIALET_MAX_WORKERS];
+// When a worker that died right away is due to be started again, in
+// milliseconds of the monotonic clock. 0 while the slot is not waiting.
+static long long             http_worker_restart_at[BIALET_MAX_WORKERS];
 static int                   cron_installed = 0;
 static char*                 cron_code = 0;
 
@@ -237,10 +254,11 @@ static void dmon_callback(dmon_watch_id watch_id, dmon_action action,
   (void)watch_id;
   (void)action;
   (void)rootdir;
-  (void)oldfilepath;
   (void)user;
+  server_file_changed(oldfilepath);
   if(filepath) {
     livereload_notify();
+    server_file_changed(filepath);
     const char* ext = strrchr(filepath, '.');
     if(ext && !strcmp(ext, BIALET_EXTENSION)) {
       trigger_reload_files(filepath);
@@ -250,7 +268,12 @@ static void dmon_callback(dmon_watch_id watch_id, dmon_action action,
 
 char* server_url(int port) {
   static char url[MAX_URL];
-  snprintf(url, MAX_URL, "http://%s:%d", bialet_config.host, port);
+  if(bialet_config.socket_path != NULL)
+    snprintf(url, MAX_URL, "unix:%s", bialet_config.socket_path);
+  else if(strchr(bialet_config.host, ':') != NULL && bialet_config.host[0] != '[')
+    snprintf(url, MAX_URL, "http://[%s]:%d", bialet_config.host, port);
+  else
+    snprintf(url, MAX_URL, "http://%s:%d", bialet_config.host, port);
   return url;
 }
 
@@ -276,18 +299,101 @@ static void open_browser(const char* url) {
 #endif
 }
 
+#ifndef _WIN32
+static long long monotonic_ms(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static long elapsed_ms(const struct timespec* since) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (long)(now.tv_sec - since->tv_sec) * 1000 +
+         (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static void restart_message(int slot) {
+  if(bialet_config.workers > 1) {
+    char slot_str[12];
+    snprintf(slot_str, sizeof(slot_str), "%d", slot + 1);
+    message(red("Error"), "Restarting worker", slot_str);
+  } else {
+    message(red("Error"), "Restarting");
+  }
+}
+
+// Forks the HTTP worker for [slot]. The child never returns: it serves until
+// the shutdown signal and exits 0, or dies and is respawned by the supervisor
+// loop in main().
+static void spawn_http_worker(int slot, const struct rlimit* mem_limit,
+                              const struct rlimit* cpu_limit) {
+  pid_t pid = fork();
+  if(pid < 0) {
+    perror("fork");
+    exit(1);
+  }
+  if(pid > 0) {
+    http_worker_pids[slot] = (sig_atomic_t)pid;
+    clock_gettime(CLOCK_MONOTONIC, &http_worker_started[slot]);
+    return;
+  }
+  // The slots describe the supervisor's children; a worker forwarding a
+  // signal to a sibling's (possibly recycled) PID would be wrong.
+  for(int i = 0; i < BIALET_MAX_WORKERS; i++)
+    http_worker_pids[i] = 0;
+  // The sqlite connection was opened in the parent before fork() and is
+  // still used by the parent's cron/dmon threads. SQLite forbids sharing
+  // a connection across fork(); open our own fresh connection so the HTTP
+  // worker never touches the shared pre-fork handle.
+  bialet_reopen_db();
+  if(server_open_worker_listener() != 0)
+    exit(1);
+  bialet_warm_vm();
+  // Set cpu time and memory limit. RLIMIT_AS is Linux-only here: on
+  // Darwin, setrlimit(RLIMIT_AS, ...) rejects any value below the
+  // process's already-huge virtual address-space reservation (bialet's
+  // own libmalloc VM zones alone exceed the configured soft/hard limits
+  // by orders of magnitude at process start), so it always fails with
+  // EINVAL and would crash-loop every child. RLIMIT_CPU is enforced
+  // correctly on both platforms.
+#if IS_LINUX
+  if(setrlimit(RLIMIT_AS, mem_limit) == -1) {
+    perror("setrlimit");
+    exit(1);
+  }
+#else
+  (void)mem_limit;
+#endif
+  if(setrlimit(RLIMIT_CPU, cpu_limit) == -1) {
+    perror("setrlimit");
+    exit(1);
+  }
+  while(keep_running) {
+    server_poll(SERVER_POLL_DELAY);
+  }
+  // Closing the listening socket (and logging it) happens here on the
+  // normal path rather than inside the signal handler.
+  stop_server();
+  bialet_report_stats();
+  exit(0);
+}
+#endif
+
 // Async-signal-safe. The old handler called stop_server(), which calls
 // message() -> malloc/localtime/fprintf/fflush; none of those are on the POSIX
 // async-signal-safe list, so a signal arriving inside an allocation or an
 // flush could deadlock or corrupt state. Only the flag is set here (and kill(),
-// which is async-signal-safe, to forward shutdown to the HTTP child); the
+// which is async-signal-safe, to forward shutdown to the HTTP workers); the
 // socket is closed on the normal path once the poll loop observes the flag.
 void sigint_handler(int signum) {
   keep_running = 0;
 #ifndef _WIN32
-  pid_t child = (pid_t)http_child_pid;
-  if(child > 0)
-    kill(child, signum);
+  for(int i = 0; i < BIALET_MAX_WORKERS; i++) {
+    pid_t child = (pid_t)http_worker_pids[i];
+    if(child > 0)
+      kill(child, signum);
+  }
 #else
   (void)signum;
 #endif
@@ -361,7 +467,6 @@ int main(int argc, char* argv[]) {
 #endif
 
 #ifndef _WIN32
-  pid_t         pid;
   struct rlimit mem_limit;
   struct rlimit cpu_limit;
 
@@ -385,6 +490,11 @@ int main(int argc, char* argv[]) {
   bialet_config.ignored_files = IGNORED_FILES;
   bialet_config.max_upload_size = 2 * 1024 * 1024; // Default 2MB
   bialet_config.max_post_size = 128 * 1024;        // Default 128KB
+  bialet_config.workers = 1;
+  bialet_config.socket_path = NULL;
+  bialet_config.backlog = BIALET_DEFAULT_BACKLOG;
+  bialet_config.bytecode_cache = 1;
+  bialet_config.arena = 0;
   /* SQLite pragma defaults */
   bialet_config.sqlite_foreign_keys = 1; // ON
   bialet_config.sqlite_synchronous = 1;  // NORMAL
@@ -539,7 +649,7 @@ int main(int argc, char* argv[]) {
     bialet_enable_dev_flags();
   livereload_init();
   show_errors_init();
-  if(dev_mode && !bialet_config.quiet)
+  if(dev_mode && !bialet_config.quiet && bialet_config.socket_path == NULL)
     open_browser(server_url(port));
 
 #ifndef _WIN32
@@ -559,77 +669,114 @@ int main(int argc, char* argv[]) {
   cpu_limit.rlim_cur = (rlim_t)bialet_config.cpu_soft_limit;
   cpu_limit.rlim_max = (rlim_t)bialet_config.cpu_hard_limit;
 
-  for(;;) {
-    pid = fork();
-    if(pid == 0) {
-      // The sqlite connection was opened in the parent before fork() and is
-      // still used by the parent's cron/dmon threads. SQLite forbids sharing
-      // a connection across fork(); open our own fresh connection so the HTTP
-      // child never touches the shared pre-fork handle.
-      bialet_reopen_db();
-      // Set cpu time and memory limit. RLIMIT_AS is Linux-only here: on
-      // Darwin, setrlimit(RLIMIT_AS, ...) rejects any value below the
-      // process's already-huge virtual address-space reservation (bialet's
-      // own libmalloc VM zones alone exceed the configured soft/hard limits
-      // by orders of magnitude at process start), so it always fails with
-      // EINVAL and would crash-loop every child. RLIMIT_CPU is enforced
-      // correctly on both platforms.
-#if IS_LINUX
-      if(setrlimit(RLIMIT_AS, &mem_limit) == -1) {
-        perror("setrlimit");
-        exit(1);
-      }
-#endif
-      if(setrlimit(RLIMIT_CPU, &cpu_limit) == -1) {
-        perror("setrlimit");
-        exit(1);
-      }
-      while(keep_running) {
-        server_poll(SERVER_POLL_DELAY);
-      }
-      // Closing the listening socket (and logging it) happens here on the
-      // normal path rather than inside the signal handler.
-      stop_server();
-      exit(0);
-    } else if(pid > 0) {
-      http_child_pid = (sig_atomic_t)pid;
-      // Parent: wait for the HTTP child specifically. `wait()` would also
-      // reap the browser child forked by open_browser() in dev mode and, if
-      // that one exited cleanly first, tear down dmon and exit while the
-      // HTTP child still serves.
-      //
-      // waitpid's result was previously ignored while `status` was
-      // uninitialized. There is no SA_RESTART on our handlers, so a SIGINT or
-      // SIGTERM makes waitpid fail with EINTR without ever writing `status` --
-      // and WIFEXITED then inspected an indeterminate value, sometimes
-      // breaking the loop and sometimes respawning a child at random.
-      status = 0;
-      pid_t waited;
-      do {
-        waited = waitpid(pid, &status, 0);
-      } while(waited < 0 && errno == EINTR && keep_running);
-
-      http_child_pid = 0;
-      if(waited < 0) {
+  if(bialet_config.workers > 1) {
+    char workers_str[12];
+    snprintf(workers_str, sizeof(workers_str), "%d", bialet_config.workers);
+    message(yellow("Workers"), workers_str);
+  }
+  int running = 0;
+  int waiting = 0;
+  int given_up = 0;
+  for(int i = 0; i < bialet_config.workers; i++) {
+    spawn_http_worker(i, &mem_limit, &cpu_limit);
+    running++;
+  }
+  while(running > 0 || waiting > 0) {
+    // Workers whose restart delay is over are started again. While any other
+    // is still waiting, the wait below only polls, so its delay never holds
+    // back reaping and restarting the rest.
+    long long now = monotonic_ms();
+    long long pause = WORKER_REAP_POLL_MS;
+    for(int i = 0; waiting > 0 && i < bialet_config.workers; i++) {
+      if(http_worker_restart_at[i] == 0)
+        continue;
+      if(!keep_running || now >= http_worker_restart_at[i]) {
+        http_worker_restart_at[i] = 0;
+        waiting--;
         if(!keep_running)
-          break; // shutting down: stop supervising
-        perror("waitpid");
-        break;
+          continue;
+        restart_message(i);
+        spawn_http_worker(i, &mem_limit, &cpu_limit);
+        running++;
+      } else if(http_worker_restart_at[i] - now < pause) {
+        pause = http_worker_restart_at[i] - now;
       }
-      if(WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+    }
+    // Parent: wait for any child and match it against the worker slots. The
+    // browser child forked by open_browser() in dev mode is reaped here too
+    // and ignored, so it can neither be mistaken for a worker nor linger as a
+    // zombie.
+    //
+    // There is no SA_RESTART on our handlers, so a SIGINT or SIGTERM makes
+    // waitpid fail with EINTR without ever writing `status`; it is reset on
+    // every pass so an indeterminate value is never inspected.
+    status = 0;
+    pid_t waited = waitpid(-1, &status, waiting > 0 ? WNOHANG : 0);
+    if(waited == 0 || (waited < 0 && errno == ECHILD && waiting > 0)) {
+      // A shutdown signal cuts the pause short.
+      struct timespec wait = {(time_t)(pause / 1000),
+                              (long)(pause % 1000) * 1000000};
+      nanosleep(&wait, NULL);
+      continue;
+    }
+    if(waited < 0) {
+      if(errno == EINTR && keep_running)
+        continue;
+      if(!keep_running)
+        break; // shutting down: stop supervising
+      perror("waitpid");
+      break;
+    }
+    int slot = -1;
+    for(int i = 0; i < bialet_config.workers; i++) {
+      if((pid_t)http_worker_pids[i] == waited) {
+        slot = i;
         break;
-      } else if(!keep_running) {
-        break; // child stopped because we are shutting down
-      } else {
-        message(red("Error"), "Restarting");
       }
+    }
+    if(slot < 0)
+      continue;
+    http_worker_pids[slot] = 0;
+    running--;
+    if(WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+      continue; // the worker stopped cleanly
+    } else if(!keep_running) {
+      continue; // worker stopped because we are shutting down
+    }
+    // Only the dead worker is replaced; the others keep serving. One that
+    // cannot even start (the port is taken, the socket path is wrong) would
+    // otherwise be forked again and again as fast as it fails, so it waits
+    // for its turn at the top of the loop instead.
+    if(elapsed_ms(&http_worker_started[slot]) >= WORKER_QUICK_EXIT_MS) {
+      http_worker_quick_exits[slot] = 0;
+    } else if(++http_worker_quick_exits[slot] >= WORKER_MAX_QUICK_EXITS) {
+      char slot_str[12];
+      snprintf(slot_str, sizeof(slot_str), "%d", slot + 1);
+      message(red("Error"), "Worker keeps failing to start, giving up on it",
+              slot_str);
+      given_up++;
+      continue;
     } else {
-      perror("fork");
-      exit(1);
+      long long delay = WORKER_RESTART_DELAY_MS;
+      for(int i = 1; i < http_worker_quick_exits[slot] &&
+                     delay < WORKER_RESTART_MAX_DELAY_MS;
+          i++)
+        delay *= 2;
+      if(delay > WORKER_RESTART_MAX_DELAY_MS)
+        delay = WORKER_RESTART_MAX_DELAY_MS;
+      http_worker_restart_at[slot] = monotonic_ms() + delay;
+      waiting++;
+      continue;
     }
+    restart_message(slot);
+    spawn_http_worker(slot, &mem_limit, &cpu_limit);
+    running++;
   }
 
   dmon_deinit();
+  server_remove_socket();
+  if(given_up > 0 && running == 0 && keep_running)
+    exit(1);
 #endif
 
 // Windows has no fork(), so it cannot reuse the process-per-cycle
@@ -0,0 +1,264 @@
+/*
+ * This file is part of Bialet, which is licensed under the
+ * MIT License.
+ *
+ * Copyright (c) 2023-2026 Rodrigo Arce
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * For full license text, see LICENSE.md.
+ */
+#include "query_cache.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define QUERY_CACHE_SIZE 256
+// All the entries together, and the most a single one may take.
+#define QUERY_CACHE_MAX_BYTES (16 * 1024 * 1024)
+#define QUERY_CACHE_MAX_ENTRY_BYTES (QUERY_CACHE_MAX_BYTES / 16)
+
+struct QueryCacheEntry {
+  char*                    key;
+  size_t                   key_len;
+  unsigned long            hash;
+  char*                    tables;
+  time_t                   expires;
+  unsigned long            last_used;
+  struct QueryCacheResult* result;
+};
+
+static struct QueryCacheEntry cache[QUERY_CACHE_SIZE];
+static int                    cache_count = 0;
+static size_t                 cache_bytes = 0;
+static unsigned long          cache_clock = 0;
+static long                   cache_hits = 0;
+static long                   cache_misses = 0;
+static long                   cache_invalidations = 0;
+// A bulk write reports every row, with the same name from the schema each
+// time. Once its entries are gone there is nothing left to look for until
+// another one is stored.
+static const char* last_invalidated = NULL;
+
+static unsigned long key_hash(const char* key, size_t length) {
+  unsigned long hash = 5381;
+  for(size_t i = 0; i < length; i++)
+    hash = hash * 33 + (unsigned char)key[i];
+  return hash;
+}
+
+static size_t result_bytes(const struct QueryCacheResult* result) {
+  return sizeof(struct QueryCacheResult) +
+         result->capacity * sizeof(struct QueryCacheValue) + result->data_capacity;
+}
+
+static size_t entry_bytes(const struct QueryCacheEntry* entry) {
+  return entry->key_len + strlen(entry->tables) + result_bytes(entry->result);
+}
+
+struct QueryCacheResult* query_cache_result_new(int columns) {
+  struct QueryCacheResult* result = calloc(1, sizeof(struct QueryCacheResult));
+  if(result != NULL)
+    result->columns = columns;
+  return result;
+}
+
+void query_cache_result_free(struct QueryCacheResult* result) {
+  if(result == NULL)
+    return;
+  free(result->values);
+  free(result->data);
+  free(result);
+}
+
+static struct QueryCacheValue* result_add(struct QueryCacheResult* result,
+                                          size_t length) {
+  if(result->count == result->capacity) {
+    size_t capacity = result->capacity < 16 ? 16 : result->capacity * 2;
+    void*  values = realloc(result->values, capacity * sizeof(struct QueryCacheValue));
+    if(values == NULL)
+      return NULL;
+    result->values = values;
+    result->capacity = capacity;
+  }
+  if(result->data_length + length > result->data_capacity) {
+    size_t capacity = result->data_capacity < 256 ? 256 : result->data_capacity;
+    while(capacity < result->data_length + length)
+      capacity *= 2;
+    char* data = realloc(result->data, capacity);
+    if(data == NULL)
+      return NULL;
+    result->data = data;
+    result->data_capacity = capacity;
+  }
+  if(result_bytes(result) > QUERY_CACHE_MAX_ENTRY_BYTES)
+    return NULL;
+  struct QueryCacheValue* value = &result->values[result->count++];
+  value->type = QUERY_CACHE_NULL;
+  value->number = 0;
+  value->offset = result->data_length;
+  value->length = 0;
+  return value;
+}
+
+int query_cache_result_add_null(struct QueryCacheResult* result) {
+  return result_add(result, 0) != NULL ? 0 : -1;
+}
+
+int query_cache_result_add_num(struct QueryCacheResult* result, double number) {
+  struct QueryCacheValue* value = result_add(result, 0);
+  if(value == NULL)
+    return -1;
+  value->type = QUERY_CACHE_NUM;
+  value->number = number;
+  return 0;
+}
+
+int query_cache_result_add_string(struct QueryCacheResult* result, const char* bytes,
+                                  size_t length) {
+  struct QueryCacheValue* value = result_add(result, length);
+  if(value == NULL)
+    return -1;
+  value->type = QUERY_CACHE_STRING;
+  value->length = length;
+  if(length > 0)
+    memcpy(result->data + result->data_length, bytes, length);
+  result->data_length += length;
+  return 0;
+}
+
+static void entry_remove(int index) {
+  struct QueryCacheEntry* entry = &cache[index];
+  cache_bytes -= entry_bytes(entry);
+  free(entry->key);
+  free(entry->tables);
+  query_cache_result_free(entry->result);
+  cache[index] = cache[--cache_count];
+}
+
+const struct QueryCacheResult* query_cache_get(const char* key, size_t key_len,
+                                               time_t now) {
+  unsigned long hash = key_hash(key, key_len);
+  for(int i = 0; i < cache_count; i++) {
+    struct QueryCacheEntry* entry = &cache[i];
+    if(entry->hash != hash || entry->key_len != key_len ||
+       memcmp(entry->key, key, key_len) != 0)
+      continue;
+    if(entry->expires <= now) {
+      entry_remove(i);
+      break;
+    }
+    entry->last_used = ++cache_clock;
+    cache_hits++;
+    return entry->result;
+  }
+  cache_misses++;
+  return NULL;
+}
+
+void query_cache_put(const char* key, size_t key_len, const char* tables,
+                     time_t expires, struct QueryCacheResult* result) {
+  // Two requests may both miss the same key before either stores it.
+  unsigned long hash = key_hash(key, key_len);
+  for(int i = 0; i < cache_count; i++) {
+    if(cache[i].hash == hash && cache[i].key_len == key_len &&
+       memcmp(cache[i].key, key, key_len) == 0) {
+      entry_remove(i);
+      break;
+    }
+  }
+
+  struct QueryCacheEntry entry;
+  entry.key = malloc(key_len);
+  entry.key_len = key_len;
+  entry.hash = hash;
+  entry.tables = strdup(tables);
+  entry.expires = expires;
+  entry.last_used = ++cache_clock;
+  entry.result = result;
+  if(entry.key == NULL || entry.tables == NULL) {
+    free(entry.key);
+    free(entry.tables);
+    query_cache_result_free(result);
+    return;
+  }
+  memcpy(entry.key, key, key_len);
+
+  // Make room by dropping the least recently used entries.
+  size_t bytes = entry_bytes(&entry);
+  while(cache_count > 0 &&
+        (cache_count == QUERY_CACHE_SIZE || cache_bytes + bytes > QUERY_CACHE_MAX_BYTES)) {
+    int oldest = 0;
+    for(int i = 1; i < cache_count; i++) {
+      if(cache[i].last_used < cache[oldest].last_used)
+        oldest = i;
+    }
+    entry_remove(oldest);
+  }
+  cache[cache_count++] = entry;
+  cache_bytes += bytes;
+  last_invalidated = NULL;
+}
+
+// Whether [table] is one of the newline terminated names in [tables].
+static int tables_contain(const char* tables, const char* table, size_t length) {
+  const char* line = tables;
+  while(*line != '\0') {
+    const char* end = strchr(line, '\n');
+    if(end == NULL)
+      return 0;
+    if((size_t)(end - line) == length && memcmp(line, table, length) == 0)
+      return 1;
+    line = end + 1;
+  }
+  return 0;
+}
+
+void query_cache_invalidate(const char* table) {
+  if(cache_count == 0 || table == last_invalidated)
+    return;
+  char   lower[QUERY_CACHE_TABLE_LEN];
+  size_t length = 0;
+  for(; table[length] != '\0'; length++) {
+    // A name this long is never recorded, so it cannot match either.
+    if(length == sizeof(lower))
+      return;
+    lower[length] = (char)tolower((unsigned char)table[length]);
+  }
+  for(int i = cache_count - 1; i >= 0; i--) {
+    if(tables_contain(cache[i].tables, lower, length)) {
+      entry_remove(i);
+      cache_invalidations++;
+    }
+  }
+  last_invalidated = table;
+}
+
+void query_cache_invalidate_tables(const char* tables) {
+  const char* line = tables;
+  while(cache_count > 0 && *line != '\0') {
+    const char* end = strchr(line, '\n');
+    if(end == NULL)
+      return;
+    for(int i = cache_count - 1; i >= 0; i--) {
+      if(tables_contain(cache[i].tables, line, (size_t)(end - line))) {
+        entry_remove(i);
+        cache_invalidations++;
+      }
+    }
+    line = end + 1;
+  }
+}
+
+void query_cache_clear(void) {
+  while(cache_count > 0)
+    entry_remove(cache_count - 1);
+  last_invalidated = NULL;
+}
+
+void query_cache_stats(long* hits, long* misses, long* invalidations) {
+  *hits = cache_hits;
+  *misses = cache_misses;
+  *invalidations = cache_invalidations;
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of Bialet, which is licensed under the
+ * MIT License.
+ *
+ * Copyright (c) 2023-2026 Rodrigo Arce
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * For full license text, see LICENSE.md.
+ */
+#ifndef QUERY_CACHE_H
+#define QUERY_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+
+// Rows of SELECTs run with Query.cached(ttl), kept by the worker process and
+// shared by all of its requests. An entry is keyed by the SQL and the bound
+// parameters and remembers the tables the statement reads. It is dropped when
+// a write to one of those tables is reported (see query_cache_invalidate()),
+// when the schema changes, or once its time to live is over. Writes made by
+// other workers are only seen after the time to live.
+//
+// The values are stored as they come out of SQLite, not as Wren objects, so a
+// hit builds new rows in whichever VM asks for them.
+
+#define QUERY_CACHE_NULL 0
+#define QUERY_CACHE_NUM 1
+#define QUERY_CACHE_STRING 2
+
+// Longer table names are not tracked, and statements reading them not cached.
+#define QUERY_CACHE_TABLE_LEN 256
+
+struct QueryCacheValue {
+  int    type;
+  double number;
+  // Into the data of the result, for strings.
+  size_t offset;
+  size_t length;
+};
+
+// The column names followed by the values of each row, one after the other.
+struct QueryCacheResult {
+  int                     columns;
+  size_t                  count;
+  size_t                  capacity;
+  struct QueryCacheValue* values;
+  char*                   data;
+  size_t                  data_length;
+  size_t                  data_capacity;
+};
+
+struct QueryCacheResult* query_cache_result_new(int columns);
+void                     query_cache_result_free(struct QueryCacheResult* result);
+
+// Appends a value (or a column name) to [result]. Return -1 when it could not
+// grow, or would grow past what a single entry may hold.
+int query_cache_result_add_null(struct QueryCacheResult* result);
+int query_cache_result_add_num(struct QueryCacheResult* result, double number);
+int query_cache_result_add_string(struct QueryCacheResult* result, const char* bytes,
+                                  size_t length);
+
+// The result stored under [key] until [now], counted as a hit, or NULL,
+// counted as a miss. It stays valid until the next call into the cache.
+const struct QueryCacheResult* query_cache_get(const char* key, size_t key_len,
+                                               time_t now);
+
+// Stores [result] under [key] until [expires]. [tables] lists the tables the
+// statement reads, each one followed by a newline and in lower case. The cache
+// takes [result], and frees it right away if it cannot be kept.
+void query_cache_put(const char* key, size_t key_len, const char* tables,
+                     time_t expires, struct QueryCacheResult* result);
+
+// Drops every entry that read [table], which was just written.
+void query_cache_invalidate(const char* table);
+// The same for each of [tables], listed as query_cache_put() takes them.
+void query_cache_invalidate_tables(const char* tables);
+void query_cache_clear(void);
+
+void query_cache_stats(long* hits, long* misses, long* invalidations);
+
+#endif
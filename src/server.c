@@ -26,13 +26,26 @@
 #else
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <poll.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <time.h>
+#if IS_LINUX
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#endif
 #include <unistd.h>
 #if IS_MAC
 #include <mach/mach_time.h>
 #endif
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
 typedef int bialet_socket_t;
 #define BIALET_INVALID_SOCKET (-1)
 #define socket_close(s) close(s)
@@ -40,6 +53,7 @@ typedef int bialet_socket_t;
 #endif
 
 #include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <limits.h>
 #include <stddef.h>
@@ -50,6 +64,10 @@ typedef int bialet_socket_t;
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #ifndef NAME_MAX
 #define NAME_MAX 255
 #endif
@@ -64,13 +82,121 @@ typedef int bialet_socket_t;
 // bounded to a few seconds.
 #define BIALET_SOCKET_TIMEOUT_MS (5000)
 
+// Persistent connections: an idle keep-alive connection is closed after
+// BIALET_KEEPALIVE_TIMEOUT_S seconds, and after BIALET_KEEPALIVE_MAX_REQUESTS
+// requests so one client cannot pin a connection slot forever.
+#define BIALET_KEEPALIVE_TIMEOUT_S "5"
+#define BIALET_KEEPALIVE_TIMEOUT_MS (5000)
+#define BIALET_KEEPALIVE_MAX_REQUESTS (100)
+
 // Total wall-clock budget for reading a request body. The per-recv SO_RCVTIMEO
 // only bounds a single recv() call, so a peer that dribbles bytes just under
 // that timeout could otherwise hold the single-threaded accept loop forever.
 #define BIALET_BODY_READ_DEADLINE_MS (30000)
 
+// SO_REUSEPORT only spreads incoming connections across listeners on Linux;
+// BSD and macOS accept the option but hand every connection to the last
+// socket bound. Elsewhere the workers share the supervisor's listening socket.
+#if IS_LINUX && defined(SO_REUSEPORT)
+#define BIALET_HAVE_REUSEPORT 1
+#else
+#define BIALET_HAVE_REUSEPORT 0
+#endif
+
 bialet_socket_t            server_fd = BIALET_INVALID_SOCKET;
 static struct BialetConfig bialet_config;
+// Set when each worker opens its own SO_REUSEPORT listener. The supervisor's
+// socket is then only bound, never listening, and server_addr is the address
+// the workers bind to: IPv4, IPv6 or, with --socket, a Unix domain socket.
+static int                     reuseport_listeners = 0;
+static struct sockaddr_storage server_addr;
+static socklen_t               server_addr_len = 0;
+// Set in the supervisor once it has bound the --socket path, so only the
+// process that created the socket file removes it.
+static int socket_path_bound = 0;
+
+// The dmon watcher runs in the supervisor, so server_file_changed() bumps a
+// generation counter shared across the fork. Each worker compares it with the
+// generation its static cache and route table were built from and drops them
+// on the next request after a change.
+static volatile long  files_local_generation = 0;
+static volatile long* files_generation = &files_local_generation;
+
+// Small static files are kept in memory, keyed by the request path, so a hot
+// stylesheet or image is answered without the stat/realpath/open/read walk in
+// handle_request. Each worker fills its own cache. In case a watcher event is
+// missed, an entry older than BIALET_STATIC_CACHE_REVALIDATE_MS is checked
+// against the file's inode, size and mtime before it is served again.
+#define BIALET_STATIC_CACHE_ENTRIES 128
+#define BIALET_STATIC_CACHE_FILE_MAX (256 * 1024)
+#define BIALET_STATIC_CACHE_REVALIDATE_MS (1000)
+
+// Content codings, as bits of an Accept-Encoding mask. Static files are served
+// from a precompressed "name.br" or "name.gz" sibling when one exists; dynamic
+// responses of at least BIALET_COMPRESS_MIN bytes are gzipped on the fly.
+#define BIALET_ENCODING_GZIP 1
+#define BIALET_ENCODING_BR 2
+#define BIALET_COMPRESS_MIN 1024
+
+// Strong ETag and Last-Modified of a static file, derived from its stat.
+struct StaticValidators {
+  char etag[64];
+  char modified[32];
+};
+
+struct StaticEntry {
+  char*                   key;    // request path, before any index/route lookup
+  char*                   path;   // resolved file the body was read from
+  const char*             header; // get_content_type() of the path
+  int                     encoding; // 0, or the BIALET_ENCODING_* of a sibling
+  int                     variants; // BIALET_ENCODING_* siblings of the file
+  char*                   body;
+  size_t                  size;
+  dev_t                   dev;
+  ino_t                   ino;
+  time_t                  mtime;
+  struct StaticValidators validators;
+  long long               checked;
+  unsigned long long      used;
+};
+
+static struct StaticEntry static_cache[BIALET_STATIC_CACHE_ENTRIES];
+static unsigned long long static_cache_tick = 0;
+static long               static_cache_seen = 0;
+
+// Request paths are resolved against an in-memory tree of the root directory,
+// scanned once per worker and again after the watcher reports a change, so
+// that the stat() of every candidate (path.wren, path, index.wren, index.html
+// and each parent's _route.wren) and the realpath() checks cost nothing per
+// request. The containment and private-file checks run once, at scan time.
+// Whatever the scan leaves out (symlinks out of the root, directory loops,
+// trees deeper than BIALET_ROUTE_TABLE_MAX_DEPTH or larger than
+// BIALET_ROUTE_TABLE_MAX_NODES) is resolved by walking the filesystem.
+#define BIALET_ROUTE_TABLE_MAX_NODES 100000
+#define BIALET_ROUTE_TABLE_MAX_DEPTH 32
+
+// Outcomes of resolving a request path.
+#define ROUTE_UNKNOWN 0   // not covered by the route table: walk the filesystem
+#define ROUTE_FOUND 1     // the file to serve or run
+#define ROUTE_MISSING 2   // no file and no _route.wren: welcome page or 404
+#define ROUTE_TRAVERSAL 3 // the file resolves outside the root
+#define ROUTE_PRIVATE 4   // the file resolves onto a private file
+
+struct RouteNode {
+  char*              name;
+  char*              resolved;    // realpath of the entry
+  unsigned char      check;       // ROUTE_FOUND, ROUTE_TRAVERSAL or ROUTE_PRIVATE
+  unsigned char      is_dir;
+  unsigned char      opaque;      // a directory whose contents were not scanned
+  unsigned char      route_check; // ROUTE_* of its _route.wren, 0 when none
+  char*              route;       // realpath of its _route.wren
+  struct RouteNode** children;    // sorted by name
+  size_t             child_count;
+};
+
+static struct RouteNode* route_table = NULL;
+static int               route_table_built = 0;
+static long              route_table_seen = 0;
 
 // Portable case-insensitive compare of exactly [n] bytes.
 static int ci_ncmp(const char* a, const char* b, size_t n) {
@@ -200,11 +326,234 @@ static int is_regular_file_no_follow(const char* path, struct stat* st) {
 #endif
 }
 
+#ifndef _WIN32
+// Output the socket did not take right away. It stays on the connection and
+// goes out as the socket drains (see connection_write), so a slow reader
+// holds up only itself: waiting for it in poll() stalled every other
+// connection of the worker for up to BIALET_SOCKET_TIMEOUT_MS at a time.
+struct OutChunk {
+  struct OutChunk*   next;
+  int                file_fd; // -1 when the bytes are in memory
+  long long          file_id; // a BIALET_FILES blob, read as it is sent, or 0
+  off_t              offset;  // into the file or blob, or into the bytes
+  size_t             length;  // still to send
+  const char*        lent;    // a body of the warm VM, or NULL for data
+  struct WrenVM*     lent_vm;
+  struct WrenHandle* lent_ref; // keeps [lent] alive until it is sent
+  char               data[];
+};
+
+struct Output {
+  struct OutChunk* head;
+  struct OutChunk* tail;
+  size_t           length;  // bytes queued
+  int              closing; // close the socket once the queue is sent
+};
+
+// The output of the connection whose request is being answered, set by
+// connection_dispatch so the writers below can queue what does not fit.
+static struct Output*  serving_out = NULL;
+static bialet_socket_t serving_fd = BIALET_INVALID_SOCKET;
+
+static struct Output* output_for(bialet_socket_t fd) {
+  return serving_out != NULL && serving_fd == fd ? serving_out : NULL;
+}
+
+static void output_append(struct Output* out, struct OutChunk* chunk) {
+  chunk->next = NULL;
+  if(out->tail != NULL)
+    out->tail->next = chunk;
+  else
+    out->head = chunk;
+  out->tail = chunk;
+  out->length += chunk->length;
+}
+
+// Queues a copy of [length] bytes from [data]; the body may be a string of
+// the warm VM, which is gone by the time the socket drains.
+static int output_queue_bytes(struct Output* out, const char* data, size_t length) {
+  if(length == 0)
+    return 1;
+  struct OutChunk* chunk = (struct OutChunk*)malloc(sizeof(struct OutChunk) + length);
+  if(chunk == NULL)
+    return 0;
+  chunk->file_fd = -1;
+  chunk->file_id = 0;
+  chunk->offset = 0;
+  chunk->length = length;
+  chunk->lent = NULL;
+  chunk->lent_ref = NULL;
+  memcpy(chunk->data, data, length);
+  output_append(out, chunk);
+  return 1;
+}
+
+// Queues [length] bytes of the body of [response] from [data], which points
+// into it. A body lent by the warm VM is sent from where it is, and the queue
+// takes over the handle that keeps it alive; any other body is copied.
+static int output_queue_body(struct Output* out, struct BialetResponse* response,
+                             const char* data, size_t length) {
+  if(response->body_ref == NULL || length == 0)
+    return output_queue_bytes(out, data, length);
+  struct OutChunk* chunk = (struct OutChunk*)malloc(sizeof(struct OutChunk));
+  if(chunk == NULL)
+    return 0;
+  chunk->file_fd = -1;
+  chunk->file_id = 0;
+  chunk->offset = 0;
+  chunk->length = length;
+  chunk->lent = data;
+  chunk->lent_vm = response->body_vm;
+  chunk->lent_ref = response->body_ref;
+  response->body_ref = NULL;
+  response->body_vm = NULL;
+  output_append(out, chunk);
+  return 1;
+}
+
+// Queues [length] bytes of the file [file_fd] from [offset]. The descriptor
+// is duplicated, since the caller closes the file once the response is out of
+// its hands.
+static int output_queue_file(struct Output* out, int file_fd, off_t offset,
+                             size_t length) {
+  if(length == 0)
+    return 1;
+  struct OutChunk* chunk = (struct OutChunk*)malloc(sizeof(struct OutChunk));
+  int              fd = chunk != NULL ? dup(file_fd) : -1;
+  if(fd < 0) {
+    free(chunk);
+    return 0;
+  }
+  chunk->file_fd = fd;
+  chunk->file_id = 0;
+  chunk->offset = offset;
+  chunk->length = length;
+  chunk->lent = NULL;
+  chunk->lent_ref = NULL;
+  output_append(out, chunk);
+  return 1;
+}
+
+// Queues [length] bytes of the BIALET_FILES blob [file_id] from [offset]. They
+// are read one chunk at a time as the socket drains, never all at once.
+static int output_queue_blob(struct Output* out, long long file_id, size_t offset,
+                             size_t length) {
+  if(length == 0)
+    return 1;
+  struct OutChunk* chunk = (struct OutChunk*)malloc(sizeof(struct OutChunk));
+  if(chunk == NULL)
+    return 0;
+  chunk->file_fd = -1;
+  chunk->file_id = file_id;
+  chunk->offset = (off_t)offset;
+  chunk->length = length;
+  chunk->lent = NULL;
+  chunk->lent_ref = NULL;
+  output_append(out, chunk);
+  return 1;
+}
+
+static void output_chunk_free(struct OutChunk* chunk) {
+  if(chunk->file_fd >= 0)
+    close(chunk->file_fd);
+  bialet_body_release(chunk->lent_vm, chunk->lent_ref);
+  free(chunk);
+}
+
+static void output_clear(struct Output* out) {
+  while(out->head != NULL) {
+    struct OutChunk* next = out->head->next;
+    output_chunk_free(out->head);
+    out->head = next;
+  }
+  out->tail = NULL;
+  out->length = 0;
+}
+
+// Sends as much of [out] as [fd] takes. Returns 1 once the queue is empty, 0
+// when the socket is full again, -1 when the connection failed.
+static int output_flush(struct Output* out, bialet_socket_t fd) {
+  while(out->head != NULL) {
+    struct OutChunk* chunk = out->head;
+    ssize_t          n;
+    if(chunk->file_id != 0) {
+      char   buf[BIALET_FILE_CHUNK_SIZE];
+      size_t want = chunk->length < sizeof(buf) ? chunk->length : sizeof(buf);
+      if(!bialet_read_blob(chunk->file_id, (size_t)chunk->offset, buf, want))
+        return -1; // the file was deleted or shrank underneath us
+      n = send(fd, buf, want, 0);
+      if(n > 0)
+        chunk->offset += n;
+    } else if(chunk->file_fd < 0) {
+      const char* bytes = chunk->lent != NULL ? chunk->lent : chunk->data;
+      n = send(fd, bytes + chunk->offset, chunk->length, 0);
+      if(n > 0)
+        chunk->offset += n;
+    } else {
+#if IS_LINUX
+      n = sendfile(fd, chunk->file_fd, &chunk->offset, chunk->length);
+#else
+      char   buf[BUFFER_SIZE];
+      size_t want = chunk->length < sizeof(buf) ? chunk->length : sizeof(buf);
+      n = pread(chunk->file_fd, buf, want, chunk->offset);
+      if(n <= 0)
+        return -1; // the file shrank underneath us
+      n = send(fd, buf, (size_t)n, 0);
+      if(n > 0)
+        chunk->offset += n;
+#endif
+    }
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return 0;
+    if(n <= 0)
+      return -1;
+    chunk->length -= (size_t)n;
+    out->length -= (size_t)n;
+    if(chunk->length == 0) {
+      out->head = chunk->next;
+      if(out->head == NULL)
+        out->tail = NULL;
+      output_chunk_free(chunk);
+    }
+  }
+  return 1;
+}
+#endif
+
+// Closes the client socket after a response, or, when part of the response
+// is still queued, once that is sent.
+static void client_close(bialet_socket_t fd) {
+#ifndef _WIN32
+  struct Output* out = output_for(fd);
+  if(out != NULL && out->head != NULL) {
+    out->closing = 1;
+    return;
+  }
+#endif
+  socket_close(fd);
+}
+
+// Client sockets are non-blocking (see the event loop below). What a full
+// send buffer does not take is queued on the connection and sent as it
+// drains; anything written after that is queued behind it, to keep the order.
 static ssize_t send_all(bialet_socket_t fd, const void* buf, size_t count) {
   size_t      sent = 0;
   const char* p = (const char*)buf;
+#ifndef _WIN32
+  struct Output* out = output_for(fd);
+  if(out != NULL && out->head != NULL)
+    return output_queue_bytes(out, p, count) ? (ssize_t)count : -1;
+#endif
   while(sent < count) {
     ssize_t n = send(fd, p + sent, count - sent, 0);
+#ifndef _WIN32
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && out != NULL)
+      return output_queue_bytes(out, p + sent, count - sent) ? (ssize_t)count : -1;
+#endif
     if(n < 0)
       return n; // error (including SO_SNDTIMEO expiry)
     if(n == 0)
@@ -214,24 +563,66 @@ static ssize_t send_all(bialet_socket_t fd, const void* buf, size_t count) {
   return (ssize_t)sent;
 }
 
+// Sends the [head] and the first [body_len] bytes of the body of [response]
+// with a single writev() where the socket takes it all at once, so the body is
+// written from where it is (often a string of the warm VM) and the two do not
+// go out as separate segments. Returns 1 once both are sent or queued.
+static int send_head_body(bialet_socket_t fd, const char* head, size_t head_len,
+                          struct BialetResponse* response, size_t body_len) {
+  const char* body = response->body;
+#ifdef _WIN32
+  return send_all(fd, head, head_len) == (ssize_t)head_len &&
+         (body_len == 0 || send_all(fd, body, body_len) == (ssize_t)body_len);
+#else
+  struct Output* out = output_for(fd);
+  if(out != NULL && out->head != NULL)
+    return output_queue_bytes(out, head, head_len) &&
+           output_queue_body(out, response, body, body_len);
+  struct iovec iov[2] = {{(void*)head, head_len}, {(void*)body, body_len}};
+  int          count = body_len > 0 ? 2 : 1;
+  struct iovec* next = iov;
+  while(count > 0) {
+    ssize_t n = writev(fd, next, count);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && out != NULL) {
+      if(next == iov &&
+         !output_queue_bytes(out, (const char*)iov[0].iov_base, iov[0].iov_len))
+        return 0;
+      return body_len == 0 ||
+             output_queue_body(out, response, (const char*)iov[1].iov_base,
+                               iov[1].iov_len);
+    }
+    if(n <= 0)
+      return 0;
+    size_t sent = (size_t)n;
+    while(count > 0 && sent >= next->iov_len) {
+      sent -= next->iov_len;
+      next++;
+      count--;
+    }
+    if(count > 0) {
+      next->iov_base = (char*)next->iov_base + sent;
+      next->iov_len -= sent;
+    }
+  }
+  return 1;
+#endif
+}
+
+#ifdef _WIN32
 // Applies receive/send timeouts so a half-open or stalling connection is
 // dropped after BIALET_SOCKET_TIMEOUT_MS instead of blocking the
-// single-threaded accept/handle loop forever.
+// single-threaded accept/handle loop forever. Only the blocking Windows
+// reader needs them; the event loop enforces its own deadlines.
 static void set_socket_timeout(bialet_socket_t fd) {
-#ifdef _WIN32
   DWORD timeout_ms = BIALET_SOCKET_TIMEOUT_MS;
   setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, setsockopt_val(&timeout_ms),
              sizeof(timeout_ms));
   setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, setsockopt_val(&timeout_ms),
              sizeof(timeout_ms));
-#else
-  struct timeval tv;
-  tv.tv_sec = BIALET_SOCKET_TIMEOUT_MS / 1000;
-  tv.tv_usec = (BIALET_SOCKET_TIMEOUT_MS % 1000) * 1000;
-  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
-#endif
 }
+#endif
 
 static long long monotonic_ms(void) {
 #ifdef _WIN32
@@ -249,10 +640,11 @@ static long long monotonic_ms(void) {
 #endif
 }
 
+#ifdef _WIN32
 // Returns 1 when [fd] becomes readable within timeout_ms, 0 on timeout or
-// error. Used to enforce the total body-read deadline below.
+// error. Used by the blocking Windows reader to enforce the total body-read
+// deadline below.
 static int wait_readable(bialet_socket_t fd, int timeout_ms) {
-#ifdef _WIN32
   fd_set readfds;
   FD_ZERO(&readfds);
   FD_SET(fd, &readfds);
@@ -261,13 +653,6 @@ static int wait_readable(bialet_socket_t fd, int timeout_ms) {
   tv.tv_usec = (timeout_ms % 1000) * 1000;
   int ret = select(0, &readfds, NULL, NULL, &tv);
   return ret > 0 && FD_ISSET(fd, &readfds);
-#else
-  struct pollfd pfd;
-  pfd.fd = fd;
-  pfd.events = POLLIN;
-  int ret = poll(&pfd, 1, timeout_ms);
-  return ret > 0 && (pfd.revents & POLLIN);
-#endif
 }
 
 // Consumes the client's request body after an early rejection (e.g. HTTP 413
@@ -293,8 +678,179 @@ static void drain_request_body(bialet_socket_t fd, size_t bytes_remaining) {
     bytes_remaining -= (size_t)n;
   }
 }
+#endif
+
+// Fills server_addr from the -h host: an IPv4 or IPv6 address (brackets
+// optional) or a name, resolved once at startup. The old inet_addr() parsing
+// took IPv4 only and turned anything else into 255.255.255.255.
+static int listener_address(const char* host) {
+  char            name[256];
+  size_t          len = strlen(host);
+  struct addrinfo hints = {0};
+  struct addrinfo* res = NULL;
+  if(len >= 2 && host[0] == '[' && host[len - 1] == ']')
+    snprintf(name, sizeof(name), "%.*s", (int)(len - 2), host + 1);
+  else
+    snprintf(name, sizeof(name), "%s", host);
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  if(getaddrinfo(name, NULL, &hints, &res) != 0 || res == NULL)
+    return -1;
+  memcpy(&server_addr, res->ai_addr, res->ai_addrlen);
+  server_addr_len = (socklen_t)res->ai_addrlen;
+  freeaddrinfo(res);
+  return 0;
+}
+
+static void listener_set_port(int port) {
+  if(server_addr.ss_family == AF_INET6)
+    ((struct sockaddr_in6*)&server_addr)->sin6_port = htons((unsigned short)port);
+  else if(server_addr.ss_family == AF_INET)
+    ((struct sockaddr_in*)&server_addr)->sin_port = htons((unsigned short)port);
+}
+
+static int listener_is_tcp(void) {
+  return server_addr.ss_family == AF_INET || server_addr.ss_family == AF_INET6;
+}
+
+// Outcome of an optional socket setting, for the startup report.
+#define LISTENER_OFF 0
+#define LISTENER_ON 1
+#define LISTENER_FAILED 2
+#define LISTENER_UNSUPPORTED 3
+
+struct ListenerOptions {
+  int defer_accept;
+  int fastopen;
+};
+
+// Applies the TCP options that have to be set on the listening socket [fd]
+// before listen(). TCP_NODELAY is set on each accepted socket instead, since
+// not every system passes it on from the listener.
+static struct ListenerOptions listener_tune(bialet_socket_t fd) {
+  struct ListenerOptions result = {LISTENER_OFF, LISTENER_OFF};
+  if(!listener_is_tcp())
+    return result;
+  if(bialet_config.tcp_defer_accept) {
+#ifdef TCP_DEFER_ACCEPT
+    // Seconds to wait for the request bytes; the kernel only hands over the
+    // connection once they arrive, so a worker never wakes for an empty one.
+    int seconds = 1;
+    result.defer_accept = setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT,
+                                     setsockopt_val(&seconds), sizeof(seconds)) == 0
+                              ? LISTENER_ON
+                              : LISTENER_FAILED;
+#else
+    result.defer_accept = LISTENER_UNSUPPORTED;
+#endif
+  }
+  if(bialet_config.tcp_fastopen > 0) {
+#ifdef TCP_FASTOPEN
+#if IS_MAC
+    // macOS takes an on/off flag rather than a queue length.
+    int qlen = 1;
+#else
+    int qlen = bialet_config.tcp_fastopen;
+#endif
+    result.fastopen = setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, setsockopt_val(&qlen),
+                                 sizeof(qlen)) == 0
+                          ? LISTENER_ON
+                          : LISTENER_FAILED;
+#else
+    result.fastopen = LISTENER_UNSUPPORTED;
+#endif
+  }
+  return result;
+}
+
+static void set_tcp_nodelay(bialet_socket_t fd) {
+  int opt = 1;
+  if(bialet_config.tcp_nodelay && listener_is_tcp())
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, setsockopt_val(&opt), sizeof(opt));
+}
+
+static const char* listener_state(int state, const char* on) {
+  switch(state) {
+    case LISTENER_ON:
+      return on;
+    case LISTENER_FAILED:
+      return "failed";
+    case LISTENER_UNSUPPORTED:
+      return "not supported on this system";
+    default:
+      return "off";
+  }
+}
+
+// Prints each listener setting once, from the supervisor.
+static void listener_report(const struct ListenerOptions* options) {
+  char backlog_str[12];
+  snprintf(backlog_str, sizeof(backlog_str), "%d", bialet_config.backlog);
+  message(yellow("Listener"), "backlog", backlog_str);
+  if(!listener_is_tcp()) {
+    message(yellow("Listener"), "Unix domain socket", bialet_config.socket_path);
+    return;
+  }
+  message(yellow("Listener"), server_addr.ss_family == AF_INET6 ? "IPv6" : "IPv4");
+  message(yellow("Listener"), "TCP_NODELAY", bialet_config.tcp_nodelay ? "on" : "off");
+  message(yellow("Listener"), "TCP_DEFER_ACCEPT",
+          (char*)listener_state(options->defer_accept, "on"));
+  char fastopen_str[12];
+  snprintf(fastopen_str, sizeof(fastopen_str), "%d", bialet_config.tcp_fastopen);
+  message(yellow("Listener"), "TCP_FASTOPEN",
+          (char*)listener_state(options->fastopen, fastopen_str));
+}
+
+#ifndef _WIN32
+// Binds and listens on the --socket path. A socket file left by a run that was
+// killed would make bind() fail, so one nobody answers on is removed first;
+// one that still accepts connections belongs to a running server.
+static int start_unix_listener(const char* path) {
+  struct sockaddr_un* addr = (struct sockaddr_un*)&server_addr;
+  if(strlen(path) >= sizeof(addr->sun_path)) {
+    message(red("Socket path too long"), (char*)path);
+    return -1;
+  }
+  memset(&server_addr, 0, sizeof(server_addr));
+  addr->sun_family = AF_UNIX;
+  memcpy(addr->sun_path, path, strlen(path) + 1);
+  server_addr_len = (socklen_t)sizeof(struct sockaddr_un);
+
+  server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(server_fd == BIALET_INVALID_SOCKET) {
+    perror("Failed to create socket");
+    return -1;
+  }
+  struct stat st;
+  if(lstat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+    // Only a refused connection shows the socket is stale. Any other failure
+    // (a full backlog, no permission) may be a live server's socket.
+    if(connect(server_fd, (struct sockaddr*)&server_addr, server_addr_len) == 0 ||
+       errno != ECONNREFUSED) {
+      message(red("Socket already in use"), (char*)path);
+      return -1;
+    }
+    unlink(path);
+  }
+  if(bind(server_fd, (struct sockaddr*)&server_addr, server_addr_len) == -1) {
+    message(red("Could not bind socket"), (char*)path, strerror(errno));
+    return -1;
+  }
+  socket_path_bound = 1;
+  if(listen(server_fd, bialet_config.backlog) == -1) {
+    perror("Failed to listen on socket");
+    return -1;
+  }
+  return 0;
+}
+#endif
 
-void handle_client(bialet_socket_t client_socket);
+void server_remove_socket() {
+  if(socket_path_bound && bialet_config.socket_path != NULL)
+    unlink(bialet_config.socket_path);
+  socket_path_bound = 0;
+}
 
 int start_server(struct BialetConfig* config) {
 #ifdef _WIN32
@@ -305,7 +861,35 @@ int start_server(struct BialetConfig* config) {
   }
 #endif
   bialet_config = *config;
-  server_fd = socket(AF_INET, SOCK_STREAM, 0);
+#if IS_LINUX || IS_MAC
+  // Mapped before the workers are forked so the supervisor's bumps reach them.
+  void* generation = mmap(NULL, sizeof(long), PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if(generation != MAP_FAILED)
+    files_generation = (volatile long*)generation;
+#endif
+  struct ListenerOptions options = {LISTENER_OFF, LISTENER_OFF};
+  if(config->socket_path != NULL) {
+#ifndef _WIN32
+    // Workers share this socket: SO_REUSEPORT does not balance Unix sockets.
+    if(start_unix_listener(config->socket_path) != 0) {
+      if(server_fd != BIALET_INVALID_SOCKET)
+        socket_close(server_fd);
+      server_remove_socket();
+      exit(EXIT_FAILURE);
+    }
+    listener_report(&options);
+    return 0;
+#else
+    message(red("Unix domain sockets are not supported on Windows"));
+    exit(EXIT_FAILURE);
+#endif
+  }
+  if(listener_address(config->host) != 0) {
+    message(red("Could not resolve host"), config->host);
+    exit(EXIT_FAILURE);
+  }
+  server_fd = socket(server_addr.ss_family, SOCK_STREAM, 0);
   if(server_fd == BIALET_INVALID_SOCKET) {
     perror("Failed to create socket");
     exit(EXIT_FAILURE);
@@ -318,25 +902,38 @@ int start_server(struct BialetConfig* config) {
     socket_close(server_fd);
     exit(EXIT_FAILURE);
   }
+#if BIALET_HAVE_REUSEPORT
+  // With several workers each one listens on its own socket and the kernel
+  // balances connections between them. The supervisor binds (so the port
+  // search below still fails over on a busy port) but never listens: a
+  // listening socket nobody accepts on would take its share of connections
+  // and leave them hanging in its backlog.
+  if(config->workers > 1) {
+    if(setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, setsockopt_val(&opt),
+                  sizeof(opt)) == -1) {
+      perror("Failed to set SO_REUSEPORT");
+      socket_close(server_fd);
+      exit(EXIT_FAILURE);
+    }
+    reuseport_listeners = 1;
+  }
+#endif
+  options = listener_tune(server_fd);
 
-  struct sockaddr_in server_addr = {
-      .sin_family = AF_INET,
-      .sin_addr.s_addr = inet_addr(config->host),
-      .sin_port = htons(config->port),
-  };
   int port;
   int initial_port = config->port < 0 ? BIALET_DEFAULT_PORT : config->port;
   int max_retries = config->port < 0 ? 10 : 1;
 
   for(int retries = 0; retries < max_retries; retries++) {
     port = initial_port + retries;
-    server_addr.sin_port = htons(port);
-    if(bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+    listener_set_port(port);
+    if(bind(server_fd, (struct sockaddr*)&server_addr, server_addr_len) == -1) {
       continue;
     }
-    if(listen(server_fd, 10) == -1) {
+    if(!reuseport_listeners && listen(server_fd, config->backlog) == -1) {
       continue;
     }
+    listener_report(&options);
     return port;
   }
   /* 12 bytes, not 10: an int needs 11 characters plus the terminator
@@ -361,7 +958,47 @@ int start_server(struct BialetConfig* config) {
   return -1;
 }
 
+int server_open_worker_listener() {
+#if BIALET_HAVE_REUSEPORT
+  if(!reuseport_listeners)
+    return 0;
+  bialet_socket_t fd = socket(server_addr.ss_family, SOCK_STREAM, 0);
+  if(fd == BIALET_INVALID_SOCKET) {
+    perror("Failed to create worker socket");
+    return -1;
+  }
+  int opt = 1;
+  if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, setsockopt_val(&opt), sizeof(opt)) ==
+         -1 ||
+     setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, setsockopt_val(&opt), sizeof(opt)) ==
+         -1) {
+    perror("Failed to set worker socket options");
+    socket_close(fd);
+    return -1;
+  }
+  (void)listener_tune(fd);
+  if(bind(fd, (struct sockaddr*)&server_addr, server_addr_len) == -1 ||
+     listen(fd, bialet_config.backlog) == -1) {
+    perror("Failed to open worker listener");
+    socket_close(fd);
+    return -1;
+  }
+  // The inherited supervisor socket is only bound; drop it so the worker
+  // polls the listener it owns.
+  socket_close(server_fd);
+  server_fd = fd;
+#endif
+  return 0;
+}
+
+#ifndef _WIN32
+static void connection_close_all(void);
+#endif
+
 void stop_server() {
+#ifndef _WIN32
+  connection_close_all();
+#endif
   if(server_fd != BIALET_INVALID_SOCKET) {
     socket_close(server_fd);
     server_fd = BIALET_INVALID_SOCKET;
@@ -385,7 +1022,6 @@ struct String create_string(const char* str, size_t len) {
 void clean_http_message(struct HttpMessage* hm) {
   if(!hm)
     return;
-  free(hm->message.str);
   free(hm->method.str);
   free(hm->uri.str);
   free(hm->routes.str);
@@ -437,6 +1073,8 @@ const char* get_http_status_description(int status_code) {
       return "Not Found";
     case 413:
       return "Payload Too Large";
+    case 416:
+      return "Range Not Satisfiable";
     case 429:
       return "Too Many Requests";
     case 405:
@@ -499,10 +1137,11 @@ char* get_content_type(const char* path) {
   return (char*)"Content-Type: application/octet-stream\r\n";
 }
 
-// Zeroed so that `headers` -- declared in struct HttpMessage but not populated
-// on this path -- is never left indeterminate. Returns NULL on allocation
-// failure so the caller can fail the single request instead of exiting the
-// whole server.
+// The message points into [request], which the caller keeps until it has
+// released the message with clean_http_message(). Zeroed so that `headers` --
+// declared in struct HttpMessage but not populated on this path -- is never
+// left indeterminate. Returns NULL on allocation failure so the caller can fail
+// the single request instead of exiting the whole server.
 struct HttpMessage* parse_request(char* request, size_t length) {
   struct HttpMessage* hm =
       (struct HttpMessage*)calloc(1, sizeof(struct HttpMessage));
@@ -519,7 +1158,10 @@ struct HttpMessage* parse_request(char* request, size_t length) {
   memcpy(first_line, request, line_len);
   first_line[line_len] = '\0';
 
-  hm->message = create_string(request, length);
+  // Borrowed rather than copied: [request] outlives the message, and is
+  // usually the largest thing in it.
+  hm->message.str = request;
+  hm->message.len = length;
 
   // Tokenize the request line from the bounded copy above.
   char* saveptr = NULL;
@@ -538,112 +1180,1453 @@ struct HttpMessage* parse_request(char* request, size_t length) {
   return hm;
 }
 
-void write_response(int client_socket, struct BialetResponse* response) {
-  if(!response->status) {
-    custom_error(404, response);
-  }
-
-  // `length` is authoritative. Falling back to strlen() is only safe for a
-  // body this struct owns, which is always NUL-terminated by construction; an
-  // opaque caller-owned buffer may be a zero-length or unterminated allocation.
-  size_t body_len = response->length;
-  if(body_len == 0 && response->body != NULL && response->body_owned) {
-    body_len = strlen(response->body);
+// Formats the status line and header block of a response whose body is
+// [body_len] bytes. Returns a heap string of *head_len bytes, or NULL.
+static char* response_head(int status, const char* hdr, size_t body_len,
+                           int keep_alive, size_t* head_len) {
+  const char* desc = get_http_status_description(status);
+  const char* connection = keep_alive ? "Connection: keep-alive\r\n"
+                                        "Keep-Alive: timeout=" BIALET_KEEPALIVE_TIMEOUT_S
+                                        "\r\n"
+                                      : "Connection: close\r\n";
+
+  // A 304 has no body, and a Content-Length on it would be taken as the
+  // length of the cached representation, so it is left out.
+  if(status == 304) {
+    int needed = snprintf(NULL, 0, "HTTP/1.1 %d %s\r\n%s%s\r\n", status, desc, hdr,
+                          connection);
+    char* head = needed < 0 ? NULL : (char*)malloc((size_t)needed + 1);
+    if(head == NULL) {
+      perror("Failed to allocate memory for HTTP response");
+      return NULL;
+    }
+    snprintf(head, (size_t)needed + 1, "HTTP/1.1 %d %s\r\n%s%s\r\n", status, desc,
+             hdr, connection);
+    *head_len = (size_t)needed;
+    return head;
   }
 
-  const char* desc = get_http_status_description(response->status);
-  const char* hdr = response->header ? response->header : "";
-
   // %zu rather than %lu: unsigned long is 32-bit under Windows LLP64.
   int needed = snprintf(NULL, 0,
                         "HTTP/1.1 %d %s\r\n"
-                        "%s"
+                        "%s%s"
                         "Content-Length: %zu\r\n\r\n",
-                        response->status, desc, hdr, body_len);
+                        status, desc, hdr, connection, body_len);
   if(needed < 0) {
     perror("Failed to format HTTP response");
-    socket_close(client_socket); // was leaked on this path
-    return;
+    return NULL;
   }
 
-  char* message = (char*)malloc((size_t)needed + 1);
-  if(message == NULL) {
+  char* head = (char*)malloc((size_t)needed + 1);
+  if(head == NULL) {
     perror("Failed to allocate memory for HTTP response");
-    socket_close(client_socket);
-    return;
+    return NULL;
   }
-  snprintf(message, (size_t)needed + 1,
+  snprintf(head, (size_t)needed + 1,
            "HTTP/1.1 %d %s\r\n"
-           "%s"
+           "%s%s"
            "Content-Length: %zu\r\n\r\n",
-           response->status, desc, hdr, body_len);
+           status, desc, hdr, connection, body_len);
+  *head_len = (size_t)needed;
+  return head;
+}
 
-  (void)send_all(client_socket, message, (size_t)needed);
-  free(message);
+// Set while a HEAD request is answered. Its response carries the headers,
+// Content-Length included, of the GET it stands for, but no body.
+static int head_only = 0;
 
-  if(response->body && body_len > 0) {
-    (void)send_all(client_socket, response->body, body_len);
+// Writes [response] and, unless [keep_alive] is set, closes the socket.
+// Returns 1 when the socket was left open for the next request on the same
+// connection, 0 once it is closed.
+static int write_response(bialet_socket_t client_socket,
+                          struct BialetResponse* response, int keep_alive) {
+  if(!response->status) {
+    custom_error(404, response);
+  }
+
+  // `length` is authoritative. Falling back to strlen() is only safe for a
+  // body this struct owns, which is always NUL-terminated by construction; an
+  // opaque caller-owned buffer may be a zero-length or unterminated allocation.
+  size_t body_len = response->length;
+  if(body_len == 0 && response->body != NULL && response->body_owned) {
+    body_len = strlen(response->body);
+  }
+
+  size_t head_len = 0;
+  char*  head = response_head(response->status, response->header ? response->header : "",
+                              body_len, keep_alive, &head_len);
+  if(head == NULL) {
+    client_close(client_socket); // was leaked on this path
+    return 0;
   }
 
-  socket_close(client_socket);
+  // A short write leaves the peer waiting on bytes that will never come, so
+  // the connection cannot be reused after one.
+  int sent_ok = send_head_body(client_socket, head, head_len, response,
+                               response->body && !head_only ? body_len : 0);
+  free(head);
+
+  if(keep_alive && sent_ok)
+    return 1;
+  client_close(client_socket);
+  return 0;
 }
 
-// Frees the heap-allocated body/header of a response when the ownership flags
-// indicate they belong to the struct (static strings and buffers owned by
-// other code, e.g. file_content, are left untouched).
-static void free_response_owned(struct BialetResponse* response) {
-  if(response->body_owned) {
-    free(response->body);
-    response->body = NULL;
-    response->body_owned = 0;
+// Sends [length] bytes of [file] from its current position. Linux hands the
+// copy to the kernel with sendfile(), straight from the page cache; elsewhere
+// the file goes out one BUFFER_SIZE chunk at a time. Either way memory use is
+// constant however large the file is, and what the socket does not take is
+// queued by descriptor and offset rather than read in. Returns 1 when every
+// byte was sent or queued.
+static int send_file_body(bialet_socket_t client_socket, FILE* file, size_t length) {
+#ifndef _WIN32
+  struct Output* out = output_for(client_socket);
+  int            in_fd = fileno(file);
+  off_t          offset = ftello(file);
+  if(offset < 0)
+    return 0;
+  if(out != NULL && out->head != NULL)
+    return output_queue_file(out, in_fd, offset, length);
+#endif
+#if IS_LINUX
+  while(length > 0) {
+    ssize_t n = sendfile(client_socket, in_fd, &offset, length);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && out != NULL)
+      return output_queue_file(out, in_fd, offset, length);
+    if(n <= 0)
+      return 0; // error, or the file shrank underneath us
+    length -= (size_t)n;
   }
-  if(response->header_owned) {
-    free(response->header);
-    response->header = NULL;
-    response->header_owned = 0;
+  return 1;
+#else
+  char chunk[BUFFER_SIZE];
+  while(length > 0) {
+    size_t want = length < sizeof(chunk) ? length : sizeof(chunk);
+    size_t got = fread(chunk, 1, want, file);
+    if(got == 0)
+      return 0;
+    if(send_all(client_socket, chunk, got) != (ssize_t)got)
+      return 0;
+    length -= got;
+#ifndef _WIN32
+    // Once the socket is full, queue the rest of the file instead of reading
+    // it into memory one chunk at a time.
+    offset += (off_t)got;
+    if(out != NULL && out->head != NULL)
+      return output_queue_file(out, in_fd, offset, length);
+#endif
   }
+  return 1;
+#endif
 }
 
-// Opens [path] without following a symlink as any component. On POSIX the
-// caller is expected to have already validated [path] with realpath() for root
-// containment; O_NOFOLLOW per component closes the TOCTOU window where the
-// file or an intermediate directory is swapped for an out-of-root symlink
-// between the check and the open. On Windows the shared helper opens with
-// FILE_FLAG_OPEN_REPARSE_POINT and rejects reparse points (junctions/symlinks)
-// instead of following them.
-static FILE* open_file_within_root(const char* path) {
-  return open_file_no_follow(path);
+// Like write_response, for a body streamed from [file] instead of being read
+// into memory first.
+static int write_file_response(bialet_socket_t client_socket, int status,
+                               const char* hdr, FILE* file, size_t length,
+                               int keep_alive) {
+  size_t head_len = 0;
+  char*  head = response_head(status, hdr, length, keep_alive, &head_len);
+  if(head == NULL) {
+    client_close(client_socket);
+    return 0;
+  }
+  int sent_ok = send_all(client_socket, head, head_len) == (ssize_t)head_len;
+  free(head);
+  if(sent_ok && length > 0 && !head_only)
+    sent_ok = send_file_body(client_socket, file, length);
+  if(keep_alive && sent_ok)
+    return 1;
+  client_close(client_socket);
+  return 0;
 }
 
-// Resolves [path] to an absolute path inside the application root, writing the
-// result into [resolved] (PATH_SIZE). Returns 1 on success, 0 when the path
-// cannot be resolved or escapes the root (symlinked outside it).
-static int resolve_within_root(const char* path, char* resolved) {
-  if(realpath_n(path, resolved, PATH_SIZE) == NULL)
+// Copies the value of request header [name] into [out] (of [out_size] bytes)
+// with surrounding blanks trimmed. Returns 1 when the header is present and
+// fits, 0 otherwise.
+static int request_header(const char* request, size_t length, const char* name,
+                          char* out, size_t out_size) {
+  size_t hdr_len = header_block_len(request, length);
+  if(hdr_len == 0)
+    hdr_len = length;
+  const char* v = find_header(request, hdr_len, name, strlen(name));
+  if(v == NULL)
     return 0;
-  size_t root_len = strlen(bialet_config.full_root_dir);
-  if(strncmp(resolved, bialet_config.full_root_dir, root_len) != 0 ||
-     (resolved[root_len] != '/' && resolved[root_len] != '\\' &&
-      resolved[root_len] != '\0')) {
+  const char* end = request + hdr_len;
+  while(v < end && (*v == ' ' || *v == '\t'))
+    v++;
+  const char* e = v;
+  while(e < end && *e != '\r' && *e != '\n')
+    e++;
+  while(e > v && (e[-1] == ' ' || e[-1] == '\t'))
+    e--;
+  size_t n = (size_t)(e - v);
+  if(n >= out_size)
     return 0;
-  }
+  memcpy(out, v, n);
+  out[n] = '\0';
   return 1;
 }
 
-void handle_client(bialet_socket_t client_socket) {
-  char   buffer[BUFFER_SIZE];
-  size_t total_read = 0;
-  size_t hdr_len = 0;
+static void static_validators(const struct stat* st, struct StaticValidators* v) {
+  snprintf(v->etag, sizeof(v->etag), "\"%llx-%llx-%llx\"",
+           (unsigned long long)st->st_ino, (unsigned long long)st->st_size,
+           (unsigned long long)st->st_mtime);
+  time_t    mtime = st->st_mtime;
+  struct tm tm;
+#ifdef _WIN32
+  gmtime_s(&tm, &mtime);
+#else
+  gmtime_r(&mtime, &tm);
+#endif
+  strftime(v->modified, sizeof(v->modified), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
 
-  // Read until the header block is complete. Taking whatever the first recv()
-  // returned meant headers split across two TCP segments -- routine for any
-  // real client -- were parsed as a truncated request. Bounded by the same
-  // wall-clock deadline used for bodies so a slow-drip peer cannot park the
-  // accept loop.
-  long long deadline = monotonic_ms() + BIALET_BODY_READ_DEADLINE_MS;
-  for(;;) {
-    long long remaining = deadline - monotonic_ms();
-    if(remaining <= 0 || total_read >= sizeof(buffer) - 1)
+// Returns 1 when [etag] is one of the entity tags in an If-None-Match [list].
+// The comparison is the weak one If-None-Match calls for, so a "W/" prefix
+// the client or a proxy added does not defeat it.
+static int etag_list_matches(const char* list, const char* etag) {
+  size_t etag_len = strlen(etag);
+  const char* p = list;
+  while(*p) {
+    while(*p == ' ' || *p == '\t' || *p == ',')
+      p++;
+    if(*p == '*')
+      return 1;
+    if(p[0] == 'W' && p[1] == '/')
+      p += 2;
+    const char* end = p;
+    while(*end && *end != ',' && *end != ' ' && *end != '\t')
+      end++;
+    if((size_t)(end - p) == etag_len && memcmp(p, etag, etag_len) == 0)
+      return 1;
+    p = end;
+  }
+  return 0;
+}
+
+// Decides whether a GET or HEAD for a file with validators [v] can be answered
+// with 304. If-None-Match wins over If-Modified-Since when both are sent. The
+// date is matched exactly against our own Last-Modified, which is what
+// browsers and CDNs echo back, so no HTTP-date parser is needed and a file
+// restored to an older mtime is still sent again.
+static int static_not_modified(const char* request, size_t length,
+                               const struct StaticValidators* v) {
+  if(strncmp(request, "GET ", 4) != 0 && strncmp(request, "HEAD ", 5) != 0)
+    return 0;
+  char value[512];
+  if(request_header(request, length, "If-None-Match", value, sizeof(value)))
+    return etag_list_matches(value, v->etag);
+  if(request_header(request, length, "If-Modified-Since", value, sizeof(value)))
+    return strcmp(value, v->modified) == 0;
+  return 0;
+}
+
+static const char* encoding_name(int encoding) {
+  return encoding == BIALET_ENCODING_BR ? "br" : "gzip";
+}
+
+static const char* encoding_suffix(int encoding) {
+  return encoding == BIALET_ENCODING_BR ? ".br" : ".gz";
+}
+
+// Brotli compresses text noticeably better than gzip, so it wins when the
+// client takes both.
+static int preferred_encoding(int mask) {
+  if(mask & BIALET_ENCODING_BR)
+    return BIALET_ENCODING_BR;
+  if(mask & BIALET_ENCODING_GZIP)
+    return BIALET_ENCODING_GZIP;
+  return 0;
+}
+
+// Returns the BIALET_ENCODING_* mask of the codings the request's
+// Accept-Encoding allows. A coding listed with q=0 is refused, and "*" stands
+// for every coding not otherwise listed.
+static int accepted_encodings(const char* request, size_t request_len) {
+  char value[256];
+  if(!request_header(request, request_len, "Accept-Encoding", value, sizeof(value)))
+    return 0;
+  int   listed = 0;
+  int   accepted = 0;
+  int   star = 0;
+  char* save = NULL;
+  for(char* token = strtok_r(value, ",", &save); token != NULL;
+      token = strtok_r(NULL, ",", &save)) {
+    while(*token == ' ' || *token == '\t')
+      token++;
+    size_t      name_len = strcspn(token, "; \t");
+    const char* q = strstr(token + name_len, "q=");
+    int         refused = q != NULL && strtod(q + 2, NULL) <= 0;
+    int         coding = 0;
+    if(name_len == 4 && ci_ncmp(token, "gzip", 4) == 0)
+      coding = BIALET_ENCODING_GZIP;
+    else if(name_len == 2 && ci_ncmp(token, "br", 2) == 0)
+      coding = BIALET_ENCODING_BR;
+    else if(name_len == 1 && token[0] == '*')
+      star = !refused;
+    listed |= coding;
+    if(!refused)
+      accepted |= coding;
+  }
+  if(star)
+    accepted |= (BIALET_ENCODING_GZIP | BIALET_ENCODING_BR) & ~listed;
+  return accepted;
+}
+
+// Returns the BIALET_ENCODING_* mask of the precompressed siblings of [path].
+static int static_variants(const char* path) {
+  int         variants = 0;
+  const int   codings[] = {BIALET_ENCODING_GZIP, BIALET_ENCODING_BR};
+  char        sibling[PATH_SIZE + 3];
+  struct stat st;
+  for(size_t i = 0; i < sizeof(codings) / sizeof(codings[0]); i++) {
+    snprintf(sibling, sizeof(sibling), "%s%s", path, encoding_suffix(codings[i]));
+    if(is_regular_file_no_follow(sibling, &st))
+      variants |= codings[i];
+  }
+  return variants;
+}
+
+static int write_not_modified(bialet_socket_t client_socket,
+                              const struct StaticValidators* v, int variants,
+                              int keep_alive) {
+  char header[192];
+  snprintf(header, sizeof(header), "%sETag: %s\r\nLast-Modified: %s\r\n",
+           variants ? "Vary: Accept-Encoding\r\n" : "", v->etag, v->modified);
+  struct BialetResponse response = {0};
+  response.status = 304;
+  response.header = header;
+  return write_response(client_socket, &response, keep_alive);
+}
+
+// Content-Type, coding and validators, for a 200 of a static file. Vary is
+// sent whenever the file has compressed siblings, so a shared cache keeps the
+// plain and the compressed copies apart.
+static void static_header(char* out, size_t out_size, const char* content_type,
+                          int encoding, int variants, const struct StaticValidators* v) {
+  snprintf(out, out_size, "%s%s%s%s%sETag: %s\r\nLast-Modified: %s\r\n",
+           content_type, encoding ? "Content-Encoding: " : "",
+           encoding ? encoding_name(encoding) : "", encoding ? "\r\n" : "",
+           variants ? "Vary: Accept-Encoding\r\n" : "", v->etag, v->modified);
+}
+
+// The part of a body a request asked for with Range. [status] is 200 for the
+// whole body, 206 for the bytes [start, start + length), or 416 when the range
+// lies past the end.
+struct ByteRange {
+  int    status;
+  size_t start;
+  size_t length;
+};
+
+// Parses an unsigned decimal at *p, advancing past it. Returns 0 when there is
+// no digit or the value overflows.
+static int parse_range_number(const char** p, size_t* out) {
+  const char* s = *p;
+  size_t      value = 0;
+  if(*s < '0' || *s > '9')
+    return 0;
+  while(*s >= '0' && *s <= '9') {
+    size_t digit = (size_t)(*s - '0');
+    if(value > (SIZE_MAX - digit) / 10)
+      return 0;
+    value = value * 10 + digit;
+    s++;
+  }
+  *p = s;
+  *out = value;
+  return 1;
+}
+
+// Resolves the Range header of a GET or HEAD against a [size]-byte body. Only
+// a single "bytes=" range is honored; a list of ranges, a malformed header or
+// an If-Range that does not match [v] (always, when there are no validators)
+// gets the whole body, as RFC 9110 allows.
+static void request_range(const char* request, size_t request_len, size_t size,
+                          const struct StaticValidators* v, struct ByteRange* range) {
+  range->status = 200;
+  range->start = 0;
+  range->length = size;
+  if(strncmp(request, "GET ", 4) != 0 && strncmp(request, "HEAD ", 5) != 0)
+    return;
+  char value[256];
+  if(!request_header(request, request_len, "Range", value, sizeof(value)) ||
+     strncmp(value, "bytes=", 6) != 0 || strchr(value, ',') != NULL)
+    return;
+  char if_range[128];
+  if(request_header(request, request_len, "If-Range", if_range, sizeof(if_range)) &&
+     (v == NULL || (strcmp(if_range, v->etag) != 0 && strcmp(if_range, v->modified) != 0)))
+    return;
+
+  const char* p = value + 6;
+  size_t      first = 0;
+  size_t      last = size ? size - 1 : 0;
+  if(*p == '-') {
+    // Suffix range: the last N bytes.
+    size_t suffix;
+    p++;
+    if(!parse_range_number(&p, &suffix) || *p != '\0')
+      return;
+    if(suffix == 0 || size == 0) {
+      range->status = 416;
+      return;
+    }
+    first = suffix < size ? size - suffix : 0;
+  } else {
+    if(!parse_range_number(&p, &first) || *p++ != '-')
+      return;
+    if(*p != '\0') {
+      size_t end;
+      if(!parse_range_number(&p, &end) || *p != '\0' || end < first)
+        return;
+      if(end < last)
+        last = end;
+    }
+    if(first >= size) {
+      range->status = 416;
+      return;
+    }
+  }
+  range->status = 206;
+  range->start = first;
+  range->length = last - first + 1;
+}
+
+// Appends Accept-Ranges and, for a 206, the Content-Range of [range] within a
+// [size]-byte body to the header block in [out].
+static void range_header_append(char* out, size_t out_size, const struct ByteRange* range,
+                                size_t size) {
+  size_t used = strlen(out);
+  if(range->status == 206)
+    snprintf(out + used, out_size - used,
+             "Accept-Ranges: bytes\r\nContent-Range: bytes %zu-%zu/%zu\r\n",
+             range->start, range->start + range->length - 1, size);
+  else
+    snprintf(out + used, out_size - used, "Accept-Ranges: bytes\r\n");
+}
+
+static int write_range_not_satisfiable(bialet_socket_t client_socket, size_t size,
+                                       int keep_alive) {
+  char header[64];
+  snprintf(header, sizeof(header), "Content-Range: bytes */%zu\r\n", size);
+  struct BialetResponse response = {0};
+  response.status = 416;
+  response.header = header;
+  return write_response(client_socket, &response, keep_alive);
+}
+
+// Sends [length] bytes of the BIALET_FILES blob [file_id] from [offset], one
+// BIALET_FILE_CHUNK_SIZE chunk at a time. Once the socket is full the rest is
+// queued by id and offset, to be read as the client takes it, so neither the
+// worker nor the queue ever holds more than a chunk of the file. Returns 1
+// when every byte was sent or queued.
+static int send_blob_body(bialet_socket_t client_socket, long long file_id,
+                          size_t offset, size_t length) {
+#ifndef _WIN32
+  struct Output* out = output_for(client_socket);
+  if(out != NULL && out->head != NULL)
+    return output_queue_blob(out, file_id, offset, length);
+#endif
+  char chunk[BIALET_FILE_CHUNK_SIZE];
+  while(length > 0) {
+    size_t want = length < sizeof(chunk) ? length : sizeof(chunk);
+    if(!bialet_read_blob(file_id, offset, chunk, want))
+      return 0;
+#ifdef _WIN32
+    if(send_all(client_socket, chunk, want) != (ssize_t)want)
+      return 0;
+    size_t sent = want;
+#else
+    ssize_t n = send(client_socket, chunk, want, 0);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && out != NULL)
+      return output_queue_blob(out, file_id, offset, length);
+    if(n <= 0)
+      return 0;
+    size_t sent = (size_t)n;
+#endif
+    offset += sent;
+    length -= sent;
+  }
+  return 1;
+}
+
+// Writes a Response.file() response, streaming the requested range of the
+// BIALET_FILES blob instead of holding the file in memory.
+static int write_file_id_response(bialet_socket_t client_socket,
+                                  struct BialetResponse* response, const char* request,
+                                  size_t request_len, int keep_alive) {
+  struct ByteRange range = {200, 0, response->length};
+  if(response->status == 200)
+    request_range(request, request_len, response->length, NULL, &range);
+  if(range.status == 416)
+    return write_range_not_satisfiable(client_socket, response->length, keep_alive);
+
+  const char* base = response->header ? response->header : "";
+  size_t      header_size = strlen(base) + 128;
+  char*       header = malloc(header_size);
+  if(header == NULL) {
+    client_close(client_socket);
+    return 0;
+  }
+  snprintf(header, header_size, "%s", base);
+  range_header_append(header, header_size, &range, response->length);
+
+  int    status = range.status == 206 ? 206 : response->status;
+  size_t head_len = 0;
+  char*  head = response_head(status, header, range.length, keep_alive, &head_len);
+  free(header);
+  if(head == NULL) {
+    client_close(client_socket);
+    return 0;
+  }
+  int sent_ok = send_all(client_socket, head, head_len) == (ssize_t)head_len;
+  free(head);
+  if(sent_ok && range.length > 0 && !head_only)
+    sent_ok = send_blob_body(client_socket, response->file_id, range.start,
+                             range.length);
+  if(keep_alive && sent_ok)
+    return 1;
+  client_close(client_socket);
+  return 0;
+}
+
+static void static_entry_clear(struct StaticEntry* e) {
+  free(e->key);
+  free(e->path);
+  free(e->body);
+  memset(e, 0, sizeof(*e));
+}
+
+// Called from the dmon callback for each changed path, relative to the root.
+// Private files (the database and its journals above all, which change on
+// every write) are never served, so only a change to a public file, or to a
+// _route.wren, invalidates the static cache and the route table.
+long server_files_generation() {
+  return *files_generation;
+}
+
+void server_file_changed(const char* filepath) {
+  if(filepath == NULL)
+    return;
+  const char* base = path_basename(filepath);
+  char        dir[PATH_SIZE];
+  snprintf(dir, sizeof(dir), "%.*s", (int)(base - filepath), filepath);
+  if(has_forbidden_uri_component(dir))
+    return;
+  if((base[0] == '_' || base[0] == '.') && strcmp(base, "_route.wren") != 0)
+    return;
+  (*files_generation)++;
+}
+
+// Finds the cached file for [key] in [encoding], or NULL. Drops everything
+// when the watcher reported a change since the last lookup, and drops the
+// entry when its revalidation stat shows the file was replaced or modified.
+static struct StaticEntry* static_cache_find(const char* key, int encoding) {
+  long generation = *files_generation;
+  if(generation != static_cache_seen) {
+    for(int i = 0; i < BIALET_STATIC_CACHE_ENTRIES; i++) {
+      if(static_cache[i].key)
+        static_entry_clear(&static_cache[i]);
+    }
+    static_cache_seen = generation;
+    return NULL;
+  }
+  for(int i = 0; i < BIALET_STATIC_CACHE_ENTRIES; i++) {
+    struct StaticEntry* e = &static_cache[i];
+    if(e->key == NULL || e->encoding != encoding || strcmp(e->key, key) != 0)
+      continue;
+    long long now = monotonic_ms();
+    if(now - e->checked >= BIALET_STATIC_CACHE_REVALIDATE_MS) {
+      struct stat st;
+      if(stat(e->path, &st) != 0 || st.st_dev != e->dev || st.st_ino != e->ino ||
+         st.st_mtime != e->mtime || (size_t)st.st_size != e->size) {
+        static_entry_clear(e);
+        return NULL;
+      }
+      e->checked = now;
+    }
+    e->used = ++static_cache_tick;
+    return e;
+  }
+  return NULL;
+}
+
+// One representation of a static file: the plain file or one of its
+// precompressed siblings.
+struct StaticFile {
+  const char*  path;
+  const char*  content_type;
+  int          encoding;
+  int          variants;
+  struct stat* st;
+};
+
+// Reads [file], the representation [f] of the request path [key], into the
+// cache, replacing an older copy or else the least recently used entry.
+// Returns the new entry, or NULL when the file is too large or cannot be read;
+// the file is then rewound so the caller can stream it instead.
+static struct StaticEntry* static_cache_store(const char* key, const struct StaticFile* f,
+                                              FILE* file) {
+  size_t size = (size_t)f->st->st_size;
+  if(size > BIALET_STATIC_CACHE_FILE_MAX || fseek(file, 0, SEEK_SET) != 0)
+    return NULL;
+
+  struct StaticEntry* e = &static_cache[0];
+  for(int i = 0; i < BIALET_STATIC_CACHE_ENTRIES; i++) {
+    struct StaticEntry* candidate = &static_cache[i];
+    if(candidate->key == NULL || (candidate->encoding == f->encoding &&
+                                  strcmp(candidate->key, key) == 0)) {
+      e = candidate;
+      break;
+    }
+    if(candidate->used < e->used)
+      e = candidate;
+  }
+  static_entry_clear(e);
+
+  e->body = malloc(size + 1);
+  e->key = strdup(key);
+  e->path = strdup(f->path);
+  if(e->body == NULL || e->key == NULL || e->path == NULL ||
+     fread(e->body, 1, size, file) != size) {
+    static_entry_clear(e);
+    rewind(file);
+    return NULL;
+  }
+  e->body[size] = '\0';
+  e->header = f->content_type;
+  e->encoding = f->encoding;
+  e->variants = f->variants;
+  e->size = size;
+  e->dev = f->st->st_dev;
+  e->ino = f->st->st_ino;
+  e->mtime = f->st->st_mtime;
+  static_validators(f->st, &e->validators);
+  e->checked = monotonic_ms();
+  e->used = ++static_cache_tick;
+  return e;
+}
+
+// Answers [request] from the cached file [e]: 304 when the client's copy is
+// current, otherwise the whole body or the requested range.
+static int write_static_entry(bialet_socket_t client_socket, const char* request,
+                              size_t request_len, struct StaticEntry* e,
+                              int keep_alive) {
+  if(static_not_modified(request, request_len, &e->validators))
+    return write_not_modified(client_socket, &e->validators, e->variants, keep_alive);
+  struct ByteRange range;
+  request_range(request, request_len, e->size, &e->validators, &range);
+  if(range.status == 416)
+    return write_range_not_satisfiable(client_socket, e->size, keep_alive);
+
+  char header[384];
+  static_header(header, sizeof(header), e->header, e->encoding, e->variants,
+                &e->validators);
+  range_header_append(header, sizeof(header), &range, e->size);
+  struct BialetResponse response = {0};
+  response.status = range.status;
+  response.header = header;
+  response.body = e->body + range.start;
+  response.length = range.length;
+  return write_response(client_socket, &response, keep_alive);
+}
+
+// Answers [request] with the representation [f] of the request path [key],
+// read from [file]. Small files go through the static cache; larger ones are
+// streamed from disk. The caller still owns [file].
+static int write_static_file(bialet_socket_t client_socket, const char* request,
+                             size_t request_len, const char* key,
+                             const struct StaticFile* f, FILE* file, int keep_alive) {
+  struct StaticEntry* cached = static_cache_store(key, f, file);
+  if(cached)
+    return write_static_entry(client_socket, request, request_len, cached, keep_alive);
+
+  size_t                  size = (size_t)f->st->st_size;
+  struct StaticValidators validators;
+  static_validators(f->st, &validators);
+  if(static_not_modified(request, request_len, &validators))
+    return write_not_modified(client_socket, &validators, f->variants, keep_alive);
+  struct ByteRange range;
+  request_range(request, request_len, size, &validators, &range);
+  if(range.status == 416)
+    return write_range_not_satisfiable(client_socket, size, keep_alive);
+  if(fseek(file, (long)range.start, SEEK_SET) != 0) {
+    perror("fseek");
+    client_close(client_socket);
+    return 0;
+  }
+  char header[384];
+  static_header(header, sizeof(header), f->content_type, f->encoding, f->variants,
+                &validators);
+  range_header_append(header, sizeof(header), &range, size);
+  return write_file_response(client_socket, range.status, header, file, range.length,
+                             keep_alive);
+}
+
+#ifdef HAVE_ZLIB
+// Returns the value of [name] in a response header block, or NULL.
+static const char* response_header_value(const char* headers, const char* name) {
+  size_t      name_len = strlen(name);
+  const char* line = headers;
+  while(line != NULL && *line) {
+    if(ci_ncmp(line, name, name_len) == 0 && line[name_len] == ':')
+      return line + name_len + 1;
+    line = strstr(line, "\r\n");
+    if(line != NULL)
+      line += 2;
+  }
+  return NULL;
+}
+
+// Text types shrink several times over; images, archives and anything
+// already encoded would only cost CPU.
+static int compressible_type(const char* type) {
+  while(*type == ' ')
+    type++;
+  return ci_ncmp(type, "text/", 5) == 0 || strstr(type, "json") != NULL ||
+         strstr(type, "javascript") != NULL || strstr(type, "xml") != NULL;
+}
+#endif
+
+// Gzips the body of a dynamic [response] in place when the client accepts it
+// and the body is a text type of at least BIALET_COMPRESS_MIN bytes. Without
+// zlib at build time responses are always sent as they are.
+static void compress_response(struct BialetResponse* response, const char* request,
+                              size_t request_len) {
+#ifdef HAVE_ZLIB
+  if(response->body == NULL || response->length < BIALET_COMPRESS_MIN ||
+     response->header == NULL ||
+     !(accepted_encodings(request, request_len) & BIALET_ENCODING_GZIP))
+    return;
+  const char* type = response_header_value(response->header, "Content-Type");
+  if(type == NULL || !compressible_type(type) ||
+     response_header_value(response->header, "Content-Encoding") != NULL)
+    return;
+
+  z_stream stream = {0};
+  // 15 window bits plus 16 selects the gzip wrapper; level 6 is zlib's own
+  // default balance between speed and size.
+  if(deflateInit2(&stream, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return;
+  uLong bound = deflateBound(&stream, (uLong)response->length);
+  char* compressed = malloc(bound + 1);
+  if(compressed == NULL) {
+    deflateEnd(&stream);
+    return;
+  }
+  stream.next_in = (Bytef*)response->body;
+  stream.avail_in = (uInt)response->length;
+  stream.next_out = (Bytef*)compressed;
+  stream.avail_out = (uInt)bound;
+  int    rc = deflate(&stream, Z_FINISH);
+  size_t compressed_len = (size_t)stream.total_out;
+  deflateEnd(&stream);
+  if(rc != Z_STREAM_END || compressed_len >= response->length) {
+    free(compressed);
+    return;
+  }
+  compressed[compressed_len] = '\0';
+
+  static const char kEncoding[] = "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n";
+  size_t            header_len = strlen(response->header);
+  char*             header = malloc(header_len + sizeof(kEncoding));
+  if(header == NULL) {
+    free(compressed);
+    return;
+  }
+  memcpy(header, response->header, header_len);
+  memcpy(header + header_len, kEncoding, sizeof(kEncoding));
+
+  if(response->body_owned)
+    free(response->body);
+  if(response->header_owned)
+    free(response->header);
+  response->body = compressed;
+  response->body_owned = 1;
+  response->length = compressed_len;
+  response->header = header;
+  response->header_owned = 1;
+#else
+  (void)response;
+  (void)request;
+  (void)request_len;
+#endif
+}
+
+// Frees the heap-allocated body/header of a response when the ownership flags
+// indicate they belong to the struct (static strings and buffers owned by
+// other code, e.g. file_content, are left untouched).
+static void free_response_owned(struct BialetResponse* response) {
+  bialet_response_release(response);
+  if(response->body_owned) {
+    free(response->body);
+    response->body = NULL;
+    response->body_owned = 0;
+  }
+  if(response->header_owned) {
+    free(response->header);
+    response->header = NULL;
+    response->header_owned = 0;
+  }
+}
+
+// Opens [path] without following a symlink as any component. On POSIX the
+// caller is expected to have already validated [path] with realpath() for root
+// containment; O_NOFOLLOW per component closes the TOCTOU window where the
+// file or an intermediate directory is swapped for an out-of-root symlink
+// between the check and the open. On Windows the shared helper opens with
+// FILE_FLAG_OPEN_REPARSE_POINT and rejects reparse points (junctions/symlinks)
+// instead of following them.
+static FILE* open_file_within_root(const char* path) {
+  return open_file_no_follow(path);
+}
+
+// Resolves [path] to an absolute path inside the application root, writing the
+// result into [resolved] (PATH_SIZE). Returns 1 on success, 0 when the path
+// cannot be resolved or escapes the root (symlinked outside it).
+static int resolve_within_root(const char* path, char* resolved) {
+  if(realpath_n(path, resolved, PATH_SIZE) == NULL)
+    return 0;
+  size_t root_len = strlen(bialet_config.full_root_dir);
+  if(strncmp(resolved, bialet_config.full_root_dir, root_len) != 0 ||
+     (resolved[root_len] != '/' && resolved[root_len] != '\\' &&
+      resolved[root_len] != '\0')) {
+    return 0;
+  }
+  return 1;
+}
+
+static void reject_too_large(bialet_socket_t client_socket) {
+  struct BialetResponse too_large = {0};
+  head_only = 0;
+  custom_error(413, &too_large);
+  write_response(client_socket, &too_large, 0);
+  free_response_owned(&too_large);
+}
+
+// Applies the containment and private-file rules to [resolved], the realpath
+// of a candidate file. A symlink named "x" -> "_db.sqlite3" passes the URI
+// check, so the canonical path must be validated too. Only the root-relative
+// portion is checked so an app hosted under a "_"/"."-named directory is not
+// blocked. The framework's own _route.wren ([is_route], found only through
+// the lstat-based route search) is exempt, and only when the resolved basename
+// is exactly "_route.wren" so a planted sub/_route.wren -> ../_db.sqlite3
+// cannot waive the boundary.
+static int route_check(const char* resolved, int is_route) {
+  size_t root_len = strlen(bialet_config.full_root_dir);
+  if(strncmp(resolved, bialet_config.full_root_dir, root_len) != 0 ||
+     (resolved[root_len] != '/' && resolved[root_len] != '\\' &&
+      resolved[root_len] != '\0'))
+    return ROUTE_TRAVERSAL;
+  int route_wren_waived = is_route && strcmp(path_basename(resolved), "_route.wren") == 0;
+  if(!route_wren_waived && has_forbidden_uri_component(resolved + root_len))
+    return ROUTE_PRIVATE;
+  return ROUTE_FOUND;
+}
+
+// Resolves the request path the way it always was, one stat() at a time:
+// [uri] is the request path without its query, [path] holds the root
+// directory joined with it (trailing slash removed) and receives the file to
+// open. A _route.wren match stores its URI prefix in [routes].
+static int route_walk(const char* uri, char* path, char* routes) {
+  char        wren_path[PATH_SIZE + 5];
+  struct stat file_stat;
+  int         is_route = 0;
+
+  if(strlen(path) + 5 < PATH_SIZE) { // 5 accounts for ".wren" and null terminator
+    snprintf(wren_path, PATH_SIZE + 5, "%s.wren", path);
+    if(stat(wren_path, &file_stat) == 0)
+      memcpy(path, wren_path, strlen(wren_path) + 1);
+  } else {
+    perror("Path too long to append .wren suffix");
+  }
+
+  if(stat(path, &file_stat) == 0 && S_ISDIR(file_stat.st_mode)) {
+    // Serve index.html or index.wren
+    strncat(path, "/index.wren", PATH_SIZE - strlen(path) - 1);
+    if(stat(path, &file_stat) != 0) {
+      // Replace the ".wren" suffix with ".html"
+      size_t L = strlen(path);
+      if(L >= 5) {
+        strncpy(path + L - 5, ".html", 6);
+      }
+    }
+  }
+
+  if(stat(path, &file_stat) != 0) {
+    // Search for _route.wren. The query is left out: a '/' inside it used to
+    // be taken for a directory boundary.
+    char url_copy[PATH_SIZE];
+    snprintf(url_copy, sizeof(url_copy), "%s", uri);
+    while(1) {
+      if(snprintf(path, PATH_SIZE, "%s%s/_route.wren", bialet_config.root_dir,
+                  url_copy) >= PATH_SIZE)
+        path[0] = '\0';
+      // lstat/no-follow: a planted sub/_route.wren -> ../_db.sqlite3 must not
+      // be accepted as a route file, otherwise realpath resolves it to the
+      // database and the route waiver skips the private-file check.
+      if(is_regular_file_no_follow(path, &file_stat)) {
+        snprintf(routes, PATH_SIZE, "%s", url_copy);
+        is_route = 1;
+        break;
+      }
+      char* last_slash = strrchr(url_copy, '/');
+      if(!last_slash) // Stop if root is reached
+        return ROUTE_MISSING;
+      *last_slash = '\0'; // Truncate to parent directory
+    }
+  }
+
+  // Validate final path is within root_dir before opening file
+  char resolved_path[PATH_SIZE];
+  if(realpath_n(path, resolved_path, sizeof(resolved_path)) != NULL) {
+    int check = route_check(resolved_path, is_route);
+    if(check != ROUTE_FOUND)
+      return check;
+    // Use the verified resolved path
+    memcpy(path, resolved_path, strlen(resolved_path) + 1);
+  }
+  return ROUTE_FOUND;
+}
+
+static int route_node_compare(const void* a, const void* b) {
+  return strcmp((*(struct RouteNode* const*)a)->name,
+                (*(struct RouteNode* const*)b)->name);
+}
+
+static void route_node_free(struct RouteNode* node) {
+  if(node == NULL)
+    return;
+  for(size_t i = 0; i < node->child_count; i++)
+    route_node_free(node->children[i]);
+  free(node->children);
+  free(node->name);
+  free(node->resolved);
+  free(node->route);
+  free(node);
+}
+
+// Binary search of [node]'s children for the [len]-byte [name].
+static struct RouteNode* route_child(const struct RouteNode* node, const char* name,
+                                     size_t len) {
+  size_t lo = 0;
+  size_t hi = node->child_count;
+  while(lo < hi) {
+    size_t      mid = lo + (hi - lo) / 2;
+    const char* child = node->children[mid]->name;
+    int         cmp = strncmp(child, name, len);
+    if(cmp == 0)
+      cmp = child[len] == '\0' ? 0 : 1;
+    if(cmp == 0)
+      return node->children[mid];
+    if(cmp < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return NULL;
+}
+
+struct RouteScan {
+  size_t nodes;
+  int    depth;
+#ifndef _WIN32
+  // Directories on the path from the root, to spot a symlink back to one.
+  dev_t devs[BIALET_ROUTE_TABLE_MAX_DEPTH];
+  ino_t inos[BIALET_ROUTE_TABLE_MAX_DEPTH];
+#endif
+};
+
+// Fills in the children of the directory [node], found at [dir_path] and
+// described by [dir_st]. Private entries are skipped, since no request path
+// can name them, except for a regular (not symlinked) _route.wren, which is
+// recorded on the directory. Returns 0 when the tree outgrows
+// BIALET_ROUTE_TABLE_MAX_NODES or memory runs out.
+static int route_scan(struct RouteNode* node, const char* dir_path,
+                      const struct stat* dir_st, struct RouteScan* scan) {
+  // A directory that resolves out of the root, leads back to one of its
+  // parents or sits too deep is left to the filesystem walk.
+  if(node->check != ROUTE_FOUND || scan->depth >= BIALET_ROUTE_TABLE_MAX_DEPTH) {
+    node->opaque = 1;
+    return 1;
+  }
+#ifndef _WIN32
+  for(int i = 0; i < scan->depth; i++) {
+    if(scan->devs[i] == dir_st->st_dev && scan->inos[i] == dir_st->st_ino) {
+      node->opaque = 1;
+      return 1;
+    }
+  }
+  scan->devs[scan->depth] = dir_st->st_dev;
+  scan->inos[scan->depth] = dir_st->st_ino;
+#else
+  (void)dir_st;
+#endif
+  DIR* dir = opendir(dir_path);
+  if(dir == NULL) {
+    node->opaque = 1;
+    return 1;
+  }
+
+  char           path[PATH_SIZE];
+  char           resolved[PATH_SIZE];
+  struct stat    st;
+  struct dirent* entry;
+  size_t         capacity = 0;
+  int            ok = 1;
+  while(ok && (entry = readdir(dir)) != NULL) {
+    const char* name = entry->d_name;
+    if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+      continue;
+    if(snprintf(path, sizeof(path), "%s/%s", dir_path, name) >= (int)sizeof(path)) {
+      node->opaque = 1;
+      continue;
+    }
+    if(strcmp(name, "_route.wren") == 0) {
+      if(is_regular_file_no_follow(path, &st)) {
+        int real = realpath_n(path, resolved, sizeof(resolved)) != NULL;
+        node->route = strdup(real ? resolved : path);
+        node->route_check = real ? (unsigned char)route_check(resolved, 1) : ROUTE_FOUND;
+        ok = node->route != NULL;
+      }
+      continue;
+    }
+    if(name[0] == '_' || name[0] == '.' || stat(path, &st) != 0)
+      continue;
+    if(++scan->nodes > BIALET_ROUTE_TABLE_MAX_NODES) {
+      ok = 0;
+      break;
+    }
+    if(node->child_count == capacity) {
+      size_t             grown = capacity ? capacity * 2 : 8;
+      struct RouteNode** children = realloc(node->children, grown * sizeof(*children));
+      if(children == NULL) {
+        ok = 0;
+        break;
+      }
+      node->children = children;
+      capacity = grown;
+    }
+    struct RouteNode* child = calloc(1, sizeof(*child));
+    if(child == NULL) {
+      ok = 0;
+      break;
+    }
+    node->children[node->child_count++] = child;
+    int real = realpath_n(path, resolved, sizeof(resolved)) != NULL;
+    child->name = strdup(name);
+    child->resolved = strdup(real ? resolved : path);
+    child->check = real ? (unsigned char)route_check(resolved, 0) : ROUTE_FOUND;
+    if(child->name == NULL || child->resolved == NULL) {
+      ok = 0;
+      break;
+    }
+    if(S_ISDIR(st.st_mode)) {
+      child->is_dir = 1;
+      scan->depth++;
+      ok = route_scan(child, path, &st, scan);
+      scan->depth--;
+    }
+  }
+  closedir(dir);
+  if(node->child_count > 1)
+    qsort(node->children, node->child_count, sizeof(*node->children),
+          route_node_compare);
+  return ok;
+}
+
+// Rebuilds the route table when the watcher reported a change since it was
+// scanned. A table that could not be built stays NULL until the next change,
+// and every request walks the filesystem meanwhile.
+static void route_table_sync(void) {
+  long generation = *files_generation;
+  if(route_table_built && generation == route_table_seen)
+    return;
+  route_node_free(route_table);
+  route_table = NULL;
+  route_table_built = 1;
+  route_table_seen = generation;
+
+  struct stat st;
+  if(stat(bialet_config.full_root_dir, &st) != 0)
+    return;
+  struct RouteNode* root = calloc(1, sizeof(*root));
+  if(root == NULL)
+    return;
+  root->is_dir = 1;
+  root->check = ROUTE_FOUND;
+  root->resolved = strdup(bialet_config.full_root_dir);
+  struct RouteScan scan = {0};
+  if(root->resolved == NULL ||
+     !route_scan(root, bialet_config.full_root_dir, &st, &scan)) {
+    route_node_free(root);
+    return;
+  }
+  route_table = root;
+}
+
+// Finds the entry at the root-relative [path] ([len] bytes), or NULL when
+// there is none. Sets *opaque when the answer lies in an unscanned directory.
+static struct RouteNode* route_lookup(const char* path, size_t len, int* opaque) {
+  struct RouteNode* node = route_table;
+  const char*       p = path;
+  const char*       end = path + len;
+  while(p < end) {
+    while(p < end && *p == '/')
+      p++;
+    if(p == end)
+      break;
+    const char* c = p;
+    while(c < end && *c != '/')
+      c++;
+    if(!node->is_dir)
+      return NULL;
+    if(node->opaque) {
+      *opaque = 1;
+      return NULL;
+    }
+    node = route_child(node, p, (size_t)(c - p));
+    if(node == NULL)
+      return NULL;
+    p = c;
+  }
+  return node;
+}
+
+// Resolves [uri] like route_walk, from the route table. Returns ROUTE_UNKNOWN
+// when the table cannot answer, and the request then walks the filesystem.
+static int route_table_resolve(const char* uri, char* path, char* routes) {
+  route_table_sync();
+  // A backslash is a separator only to Windows' stat(); let the walk decide.
+  if(route_table == NULL || strchr(uri, '\\') != NULL)
+    return ROUTE_UNKNOWN;
+
+  int    opaque = 0;
+  size_t len = strlen(uri);
+  if(len > 0 && uri[len - 1] == '/')
+    len--;
+  char candidate[PATH_SIZE + 5];
+  snprintf(candidate, sizeof(candidate), "%.*s.wren", (int)len, uri);
+  struct RouteNode* node = route_lookup(candidate, strlen(candidate), &opaque);
+  if(node == NULL && !opaque)
+    node = route_lookup(uri, len, &opaque);
+  if(opaque)
+    return ROUTE_UNKNOWN;
+  if(node != NULL && node->is_dir) {
+    if(node->opaque)
+      return ROUTE_UNKNOWN;
+    struct RouteNode* index = route_child(node, "index.wren", 10);
+    node = index != NULL ? index : route_child(node, "index.html", 10);
+  }
+  if(node != NULL) {
+    snprintf(path, PATH_SIZE, "%s", node->resolved);
+    return node->check;
+  }
+
+  char prefix[PATH_SIZE];
+  snprintf(prefix, sizeof(prefix), "%s", uri);
+  while(1) {
+    struct RouteNode* dir = route_lookup(prefix, strlen(prefix), &opaque);
+    if(opaque || (dir != NULL && dir->opaque))
+      return ROUTE_UNKNOWN;
+    if(dir != NULL && dir->route != NULL) {
+      snprintf(path, PATH_SIZE, "%s", dir->route);
+      snprintf(routes, PATH_SIZE, "%s", prefix);
+      return dir->route_check;
+    }
+    char* last_slash = strrchr(prefix, '/');
+    if(!last_slash)
+      return ROUTE_MISSING;
+    *last_slash = '\0';
+  }
+}
+
+// Routes and answers one fully buffered request. The socket is closed
+// afterwards unless [keep_alive] is set and the response went out whole;
+// returns 1 when it was left open. [full_request] stays owned by the caller.
+static int handle_request(bialet_socket_t client_socket, char* full_request,
+                          size_t total_read, int keep_alive) {
+  int                 kept = 0;
+  head_only = total_read >= 5 && memcmp(full_request, "HEAD ", 5) == 0;
+  struct HttpMessage* hm = parse_request(full_request, total_read);
+  if(hm == NULL) {
+    client_close(client_socket);
+    return 0;
+  }
+  if(!livereload_is_poll(hm->uri.str))
+    message(magenta("Request"), hm->method.str, hm->uri.str);
+
+  if(strcmp("/favicon.ico", hm->uri.str) == 0) {
+    struct BialetResponse favicon = {0};
+    favicon.status = 200;
+    favicon.header = (char*)"Content-Type: image/x-icon\r\n";
+    favicon.body = (char*)favicon_data;
+    favicon.length = FAVICON_SIZE;
+    clean_http_message(hm);
+    return write_response(client_socket, &favicon, keep_alive);
+  }
+
+  {
+    struct BialetResponse lr_response = {0};
+    if(livereload_try_handle(hm->uri.str, &lr_response)) {
+      clean_http_message(hm);
+      return write_response(client_socket, &lr_response, keep_alive);
+    }
+  }
+
+  struct BialetResponse response = {0};
+  char                  path[PATH_SIZE];
+
+  // Reject any URI whose decoded path component starts with '_' or '.'
+  // (private files such as _db.sqlite3, _route.wren, .env). This runs before
+  // any stat/fopen so "/sub/_route.wren" and "//_db.sqlite3" cannot bypass it.
+  if(has_forbidden_uri_component(hm->uri.str)) {
+    clean_http_message(hm);
+    custom_error(403, &response);
+    kept = write_response(client_socket, &response, keep_alive);
+    free_response_owned(&response);
+    return kept;
+  }
+
+  snprintf(path, PATH_SIZE, "%s%s", bialet_config.root_dir, hm->uri.str);
+  // Remove query parameters if present
+  char* query_start = strchr(path, '?');
+  if(query_start) {
+    *query_start = '\0'; // Truncate at '?'
+  }
+
+  // Check for directory traversal patterns in the URI before processing
+  if(strstr(hm->uri.str, "..") != NULL) {
+    message(red("Security Error"), "Path traversal attempt blocked", hm->uri.str);
+    clean_http_message(hm);
+    custom_error(403, &response);
+    kept = write_response(client_socket, &response, keep_alive);
+    free_response_owned(&response);
+    return kept;
+  }
+
+  // Handle routes ending with "/" or without
+  size_t pathlen = strlen(path);
+  if(pathlen > 0 && path[pathlen - 1] == '/') {
+    path[pathlen - 1] = '\0';
+  }
+
+  // The plain file's entry knows which compressed siblings exist; when the
+  // client takes one of them and it is not cached yet, the walk below finds
+  // and caches it.
+  char                cache_key[PATH_SIZE];
+  int                 accepted = accepted_encodings(full_request, total_read);
+  struct StaticEntry* cached = static_cache_find(path, 0);
+  if(cached) {
+    int encoding = preferred_encoding(accepted & cached->variants);
+    if(encoding)
+      cached = static_cache_find(path, encoding);
+  }
+  if(cached) {
+    clean_http_message(hm);
+    return write_static_entry(client_socket, full_request, total_read, cached,
+                              keep_alive);
+  }
+  memcpy(cache_key, path, PATH_SIZE);
+
+  char uri[PATH_SIZE];
+  char routes[PATH_SIZE] = "";
+  snprintf(uri, sizeof(uri), "%.*s", (int)strcspn(hm->uri.str, "?"), hm->uri.str);
+  // The watcher reports changes with some delay, so a file created a moment
+  // ago may not be in the table yet: a miss is confirmed on disk.
+  int route = route_table_resolve(uri, path, routes);
+  if(route == ROUTE_UNKNOWN || route == ROUTE_MISSING)
+    route = route_walk(uri, path, routes);
+
+  if(route == ROUTE_MISSING) {
+    // If no index.wren or index.html or _route.wren in root
+    // serve welcome page
+    if(strncmp(hm->uri.str, "/", 2) == 0) {
+      response.status = 200;
+      response.body = BIALET_WELCOME_PAGE;
+      response.length = strlen(BIALET_WELCOME_PAGE);
+      response.header = BIALET_HEADERS;
+    }
+    (void)livereload_inject_response(&response);
+    clean_http_message(hm);
+    kept = write_response(client_socket, &response, keep_alive);
+    free_response_owned(&response);
+    return kept;
+  }
+  if(route == ROUTE_TRAVERSAL || route == ROUTE_PRIVATE) {
+    message(red("Security Error"),
+            route == ROUTE_TRAVERSAL ? "Path traversal blocked"
+                                     : "Private file access blocked",
+            path);
+    clean_http_message(hm);
+    custom_error(403, &response);
+    kept = write_response(client_socket, &response, keep_alive);
+    free_response_owned(&response);
+    return kept;
+  }
+  if(routes[0] != '\0') {
+    // parse_request() already allocated an empty placeholder here, which
+    // this assignment used to drop on the floor.
+    free(hm->routes.str);
+    hm->routes = create_string(routes, strlen(routes));
+  }
+
+  // Open file and read content
+  FILE* file = open_file_within_root(path);
+  if(file == NULL) {
+    // The route table may still list a file deleted a moment ago, which is
+    // answered like any other missing page.
+    int missing = errno == ENOENT || errno == ENOTDIR;
+    if(!missing)
+      perror("Error opening file");
+    clean_http_message(hm);
+    custom_error(missing ? 404 : 500, &response);
+    kept = write_response(client_socket, &response, keep_alive);
+    free_response_owned(&response);
+    return kept;
+  }
+  if(fseek(file, 0, SEEK_END) != 0) {
+    perror("fseek");
+    fclose(file);
+    clean_http_message(hm);
+    client_close(client_socket);
+    return 0;
+  }
+  long file_size_l = ftell(file);
+  if(file_size_l < 0) {
+    perror("ftell");
+    fclose(file);
+    clean_http_message(hm);
+    client_close(client_socket);
+    return 0;
+  }
+  size_t file_size = (size_t)file_size_l;
+  rewind(file);
+
+  // Only a genuine ".wren" suffix on the final component selects the
+  // interpreter. strstr(path, ".wren") matched the substring anywhere, so
+  // "/notes.wren.txt" and "/dir.wren/style.css" were both handed to the VM as
+  // source code.
+  unsigned char is_wren_file = 0;
+  {
+    const char* base = path_basename(path);
+    size_t      base_len = strlen(base);
+    if(base_len > BIALET_EXTENSION_LEN &&
+       strcmp(base + base_len - BIALET_EXTENSION_LEN, BIALET_EXTENSION) == 0) {
+      is_wren_file = 1;
+    }
+  }
+
+  // Static files are streamed from the open file (see send_file_body), so a
+  // large download no longer costs its full size in heap under the worker's
+  // RLIMIT_AS; files up to BIALET_STATIC_CACHE_FILE_MAX are read once into the
+  // static cache instead. HTML still goes through memory while live reload is
+  // on, since the reload script is injected into the body.
+  if(!is_wren_file) {
+    char* content_type = get_content_type(path);
+    struct stat st;
+    if((!livereload_enabled() || strstr(content_type, "text/html") == NULL) &&
+       fstat(fileno(file), &st) == 0) {
+      clean_http_message(hm);
+      struct StaticFile plain = {path, content_type, 0, static_variants(path), &st};
+      int               encoding = preferred_encoding(accepted & plain.variants);
+      if(encoding) {
+        char sibling[PATH_SIZE + 3];
+        snprintf(sibling, sizeof(sibling), "%s%s", path, encoding_suffix(encoding));
+        FILE*       encoded = open_file_within_root(sibling);
+        struct stat encoded_st;
+        if(encoded != NULL && fstat(fileno(encoded), &encoded_st) == 0) {
+          struct StaticFile compressed = {sibling, content_type, encoding,
+                                          plain.variants, &encoded_st};
+          (void)static_cache_store(cache_key, &plain, file);
+          fclose(file);
+          kept = write_static_file(client_socket, full_request, total_read, cache_key,
+                                   &compressed, encoded, keep_alive);
+          fclose(encoded);
+          return kept;
+        }
+        if(encoded != NULL)
+          fclose(encoded);
+      }
+      kept = write_static_file(client_socket, full_request, total_read, cache_key,
+                               &plain, file, keep_alive);
+      fclose(file);
+      return kept;
+    }
+  }
+
+  // Always reserve room for a terminator, for wren and non-wren files alike.
+  // A zero-byte static file previously produced malloc(0), and the
+  // `length == 0 -> strlen(body)` fallback in write_response then read out of
+  // bounds to compute Content-Length and sent whatever heap bytes followed.
+  size_t alloc_size = file_size + 1;
+  char*  file_content = malloc(alloc_size);
+  if(file_content == NULL) {
+    perror("Error allocating memory for file content");
+    fclose(file);
+    clean_http_message(hm);
+    client_close(client_socket);
+    return 0;
+  }
+  size_t read_bytes = fread(file_content, 1, file_size, file);
+  if(read_bytes != file_size) {
+    perror("Error reading file");
+    free(file_content);
+    fclose(file);
+    clean_http_message(hm);
+    client_close(client_socket);
+    return 0;
+  }
+  fclose(file);
+  file_content[read_bytes] = '\0';
+
+  if(is_wren_file) {
+    response = bialet_run(path, file_content, hm);
+    if(response.length == 0 && response.body) {
+      response.length = strlen(response.body);
+    }
+  } else {
+    response.status = 200;
+    response.body = file_content;
+    response.length = read_bytes;
+    response.header = get_content_type(path);
+  }
+
+  (void)livereload_inject_response(&response);
+  clean_http_message(hm);
+  compress_response(&response, full_request, total_read);
+  if(response.file_id)
+    kept = write_file_id_response(client_socket, &response, full_request, total_read,
+                                  keep_alive);
+  else
+    kept = write_response(client_socket, &response, keep_alive);
+  free(file_content);
+  free_response_owned(&response);
+  return kept;
+}
+
+#ifdef _WIN32
+// Windows keeps the blocking reader: the event loop below is built on
+// epoll/poll and non-blocking POSIX sockets.
+void handle_client(bialet_socket_t client_socket) {
+  char   buffer[BUFFER_SIZE];
+  size_t total_read = 0;
+  size_t hdr_len = 0;
+
+  // Read until the header block is complete. Taking whatever the first recv()
+  // returned meant headers split across two TCP segments -- routine for any
+  // real client -- were parsed as a truncated request. Bounded by the same
+  // wall-clock deadline used for bodies so a slow-drip peer cannot park the
+  // accept loop.
+  long long deadline = monotonic_ms() + BIALET_BODY_READ_DEADLINE_MS;
+  for(;;) {
+    long long remaining = deadline - monotonic_ms();
+    if(remaining <= 0 || total_read >= sizeof(buffer) - 1)
       break;
     if(!wait_readable(client_socket, (int)remaining))
       break;
@@ -659,7 +2642,7 @@ void handle_client(bialet_socket_t client_socket) {
   if(total_read == 0) {
     // A peer that simply closed sets no errno, so perror() here only printed a
     // stale, misleading message.
-    socket_close(client_socket);
+    client_close(client_socket);
     return;
   }
   buffer[total_read] = '\0';
@@ -693,10 +2676,7 @@ void handle_client(bialet_socket_t client_socket) {
             drain_request_body(client_socket, declared - already);
           }
         }
-        struct BialetResponse too_large = {0};
-        custom_error(413, &too_large);
-        write_response(client_socket, &too_large);
-        free_response_owned(&too_large);
+        reject_too_large(client_socket);
         return;
       }
     }
@@ -709,7 +2689,7 @@ void handle_client(bialet_socket_t client_socket) {
       full_request = (char*)malloc(full_size + 1);
       if(!full_request) {
         perror("Failed to allocate memory for large request");
-        socket_close(client_socket);
+        client_close(client_socket);
         return;
       }
       should_free_request = 1;
@@ -732,296 +2712,399 @@ void handle_client(bialet_socket_t client_socket) {
       // expired): reject the request instead of processing a truncated one.
       if(total_read < full_size) {
         free(full_request);
-        socket_close(client_socket);
+        client_close(client_socket);
         return;
       }
       full_request[total_read] = '\0';
     }
   }
 
-  struct HttpMessage* hm = parse_request(full_request, total_read);
-  if(hm == NULL) {
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
-  }
-  if(!livereload_is_poll(hm->uri.str))
-    message(magenta("Request"), hm->method.str, hm->uri.str);
-
-  if(strcmp("/favicon.ico", hm->uri.str) == 0) {
-    (void)send_all(client_socket, FAVICON_RESPONSE, strlen(FAVICON_RESPONSE));
-    (void)send_all(client_socket, favicon_data, FAVICON_SIZE);
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
-  }
+  handle_request(client_socket, full_request, total_read, 0);
+  if(should_free_request)
+    free(full_request);
+}
+#else
+// Requests are read by an event loop (edge-triggered epoll on Linux, poll()
+// elsewhere). Every accepted socket is non-blocking and owns a buffer that
+// fills as bytes arrive, so a slow peer costs memory but never blocks the
+// worker: the old blocking reader let one client that dribbled its body hold
+// the whole process for the full 30s deadline while every other connection
+// waited in the listen backlog. A request reaches handle_request() only once
+// its header block and declared body are completely buffered.
+//
+// Connections are persistent (HTTP/1.1 keep-alive) up to
+// BIALET_KEEPALIVE_MAX_REQUESTS requests. Bytes read past the end of one
+// request stay in the buffer as the start of the next, which is how
+// pipelined requests are picked up.
+#define BIALET_MAX_CONNECTIONS 1024
+#define BIALET_MAX_EVENTS 64
+
+struct Connection {
+  bialet_socket_t fd;
+  char*           buf;
+  size_t          len;
+  size_t          cap;
+  size_t          hdr_len;   // 0 until the header block is complete
+  size_t          full_size; // header block plus declared body
+  size_t          drain;     // bytes of a rejected body still to discard
+  int             rejected;  // oversized body: drain it, then answer 413
+  int             requests;  // requests already answered on this connection
+  long long       deadline;
+  struct Output   out;       // response bytes the socket has not taken yet
+
+  struct Connection* prev;
+  struct Connection* next;
+};
+
+static struct Connection* connections = NULL;
+static int                connection_count = 0;
+#if IS_LINUX
+static int event_fd = -1;
+#endif
 
-  {
-    struct BialetResponse lr_response = {0};
-    if(livereload_try_handle(hm->uri.str, &lr_response)) {
-      write_response(client_socket, &lr_response);
-      clean_http_message(hm);
-      if(should_free_request)
-        free(full_request);
-      return;
-    }
-  }
+static int set_nonblocking(bialet_socket_t fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if(flags < 0)
+    return -1;
+  return fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
 
-  struct BialetResponse response = {0};
-  char                  path[PATH_SIZE];
-  char                  wren_path[PATH_SIZE + 5];
-  struct stat           file_stat;
-  int                   private_path_internal = 0;
+// Unlinks [c] from the connection list and frees it. The socket must already
+// be closed, which also takes it out of the epoll set.
+static void connection_free(struct Connection* c) {
+  if(c->prev)
+    c->prev->next = c->next;
+  else
+    connections = c->next;
+  if(c->next)
+    c->next->prev = c->prev;
+  connection_count--;
+  output_clear(&c->out);
+  free(c->buf);
+  free(c);
+}
 
-  // Reject any URI whose decoded path component starts with '_' or '.'
-  // (private files such as _db.sqlite3, _route.wren, .env). This runs before
-  // any stat/fopen so "/sub/_route.wren" and "//_db.sqlite3" cannot bypass it.
-  if(has_forbidden_uri_component(hm->uri.str)) {
-    clean_http_message(hm);
-    custom_error(403, &response);
-    write_response(client_socket, &response);
-    free_response_owned(&response);
-    if(should_free_request)
-      free(full_request);
-    return;
-  }
+static void connection_drop(struct Connection* c) {
+  socket_close(c->fd);
+  connection_free(c);
+}
 
-  snprintf(path, PATH_SIZE, "%s%s", bialet_config.root_dir, hm->uri.str);
-  // Remove query parameters if present
-  char* query_start = strchr(path, '?');
-  if(query_start) {
-    *query_start = '\0'; // Truncate at '?'
+// Whether the client asked to keep the connection open: the HTTP/1.1 default
+// unless it sent "Connection: close", and HTTP/1.0 only with an explicit
+// "Connection: keep-alive".
+static int request_keep_alive(const char* buf, size_t hdr_len) {
+  const char* line_end = buf;
+  while(line_end + 1 < buf + hdr_len && !(line_end[0] == '\r' && line_end[1] == '\n'))
+    line_end++;
+  size_t line_len = (size_t)(line_end - buf);
+  int http11 = line_len >= 8 && memcmp(line_end - 8, "HTTP/1.1", 8) == 0;
+
+  static const char kConnection[] = "Connection";
+  const char*       v = find_header(buf, hdr_len, kConnection, sizeof(kConnection) - 1);
+  if(v == NULL)
+    return http11;
+  const char* end = v;
+  while(end < buf + hdr_len && *end != '\r')
+    end++;
+  for(const char* p = v; p + 5 <= end; p++) {
+    if(ci_ncmp(p, "close", 5) == 0)
+      return 0;
   }
-
-  // Check for directory traversal patterns in the URI before processing
-  if(strstr(hm->uri.str, "..") != NULL) {
-    message(red("Security Error"), "Path traversal attempt blocked", hm->uri.str);
-    clean_http_message(hm);
-    custom_error(403, &response);
-    write_response(client_socket, &response);
-    free_response_owned(&response);
-    if(should_free_request)
-      free(full_request);
-    return;
+  for(const char* p = v; p + 10 <= end; p++) {
+    if(ci_ncmp(p, "keep-alive", 10) == 0)
+      return 1;
   }
+  return http11;
+}
 
-  // Handle routes ending with "/" or without
-  size_t pathlen = strlen(path);
-  if(pathlen > 0 && path[pathlen - 1] == '/') {
-    path[pathlen - 1] = '\0';
-  }
+// Closes [c] now, or once the response queued on it is sent.
+static void connection_finish(struct Connection* c) {
+  if(c->out.head == NULL)
+    connection_drop(c);
+  else
+    c->out.closing = 1;
+}
 
-  if(strlen(path) + 5 < PATH_SIZE) { // 5 accounts for ".wren" and null terminator
-    snprintf(wren_path, PATH_SIZE + 5, "%s.wren", path);
-    if(stat(wren_path, &file_stat) == 0) {
-      strncpy(path, wren_path, PATH_SIZE - 1);
-      path[PATH_SIZE - 1] = '\0'; // Ensure null termination
+// Answers the request buffered in [c]. Returns 1 when the connection stays
+// open, either for another request (any pipelined bytes are moved to the
+// front of the buffer) or to send the rest of the response, 0 once it has
+// been closed and freed.
+static int connection_dispatch(struct Connection* c) {
+  serving_out = &c->out;
+  serving_fd = c->fd;
+  if(c->rejected) {
+    reject_too_large(c->fd);
+    serving_out = NULL;
+    if(c->out.head != NULL) {
+      c->deadline = monotonic_ms() + BIALET_SOCKET_TIMEOUT_MS;
+      return 1;
     }
-  } else {
-    perror("Path too long to append .wren suffix");
+    connection_free(c);
+    return 0;
   }
-
-  if(stat(path, &file_stat) == 0 && S_ISDIR(file_stat.st_mode)) {
-    // Serve index.html or index.wren
-    strncat(path, "/index.wren", PATH_SIZE - strlen(path) - 1);
-    if(stat(path, &file_stat) != 0) {
-      // Replace the ".wren" suffix with ".html"
-      size_t L = strlen(path);
-      if(L >= 5) {
-        strncpy(path + L - 5, ".html", 6);
-      }
-    }
+  // A request served without a complete header block (truncated or too
+  // large) has no reliable end, so the connection is closed after it.
+  size_t request_len = c->hdr_len != 0 ? c->full_size : c->len;
+  int    keep_alive = c->hdr_len != 0 &&
+                   c->requests + 1 < BIALET_KEEPALIVE_MAX_REQUESTS &&
+                   request_keep_alive(c->buf, c->hdr_len);
+  // The buffer always has room past the request; the byte there may be the
+  // first one of a pipelined request, so it is restored afterwards.
+  char next_byte = c->buf[request_len];
+  c->buf[request_len] = '\0';
+  int open = handle_request(c->fd, c->buf, request_len, keep_alive);
+  serving_out = NULL;
+  if(!open && c->out.head == NULL) {
+    connection_free(c);
+    return 0;
   }
+  c->buf[request_len] = next_byte;
+  c->requests++;
+  c->len -= request_len;
+  memmove(c->buf, c->buf + request_len, c->len);
+  c->hdr_len = 0;
+  c->full_size = 0;
+  c->deadline = monotonic_ms() +
+                (c->out.head != NULL ? BIALET_SOCKET_TIMEOUT_MS
+                 : c->len > 0        ? BIALET_BODY_READ_DEADLINE_MS
+                                     : BIALET_KEEPALIVE_TIMEOUT_MS);
+  return 1;
+}
 
-  if(stat(path, &file_stat) != 0) {
-    // Search for _route.wren
-    char* url_copy = strdup(hm->uri.str);
-    if(!url_copy) {
-      perror("strdup");
-      clean_http_message(hm);
-      if(should_free_request)
-        free(full_request);
-      socket_close(client_socket);
+static void connection_accept(void) {
+  for(;;) {
+    bialet_socket_t fd = accept(server_fd, NULL, NULL);
+    if(fd == BIALET_INVALID_SOCKET) {
+      // EAGAIN: the backlog is empty (or a worker sharing the listener got
+      // the connection first).
+      if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR &&
+         errno != ECONNABORTED)
+        perror("Failed to accept connection");
       return;
     }
-    while(1) {
-      snprintf(path, PATH_SIZE, "%s%s/_route.wren", bialet_config.root_dir,
-               url_copy);
-      // lstat/no-follow: a planted sub/_route.wren -> ../_db.sqlite3 must not
-      // be accepted as a route file, otherwise realpath resolves it to the
-      // database and private_path_internal waives the private-file check.
-      if(is_regular_file_no_follow(path, &file_stat)) {
-        // parse_request() already allocated an empty placeholder here, which
-        // this assignment used to drop on the floor.
-        free(hm->routes.str);
-        hm->routes = create_string(url_copy, strlen(url_copy));
-        private_path_internal = 1;
-        break;
-      }
-      char* last_slash = strrchr(url_copy, '/');
-      if(!last_slash) { // Stop if root is reached
-        free(url_copy);
-        // If no index.wren or index.html or _route.wren in root
-        // serve welcome page
-        if(strncmp(hm->uri.str, "/", 2) == 0) {
-          response.status = 200;
-          response.body = BIALET_WELCOME_PAGE;
-          response.length = strlen(BIALET_WELCOME_PAGE);
-          response.header = BIALET_HEADERS;
-        }
-        (void)livereload_inject_response(&response);
-        clean_http_message(hm);
-        write_response(client_socket, &response);
-        free_response_owned(&response);
-        if(should_free_request)
-          free(full_request);
-        return;
-      }
-      *last_slash = '\0'; // Truncate to parent directory
+    if(connection_count >= BIALET_MAX_CONNECTIONS || set_nonblocking(fd) != 0) {
+      socket_close(fd);
+      continue;
     }
-    free(url_copy);
-  }
-
-  // Validate final path is within root_dir before opening file
-  char resolved_path[PATH_SIZE];
-  if(realpath_n(path, resolved_path, sizeof(resolved_path)) != NULL) {
-    size_t root_len = strlen(bialet_config.full_root_dir);
-    if(strncmp(resolved_path, bialet_config.full_root_dir, root_len) != 0 ||
-       (resolved_path[root_len] != '/' && resolved_path[root_len] != '\\' &&
-        resolved_path[root_len] != '\0')) {
-      message(red("Security Error"), "Path traversal blocked", path);
-      clean_http_message(hm);
-      custom_error(403, &response);
-      write_response(client_socket, &response);
-      free_response_owned(&response);
-      if(should_free_request)
-        free(full_request);
-      return;
+    set_tcp_nodelay(fd);
+    struct Connection* c = (struct Connection*)calloc(1, sizeof(*c));
+    char*              buf = (char*)malloc(BUFFER_SIZE);
+    if(c == NULL || buf == NULL) {
+      perror("Failed to allocate connection");
+      free(c);
+      free(buf);
+      socket_close(fd);
+      continue;
     }
-    // Re-apply the private-file rule to the resolved target. A symlink named
-    // "x" -> "_db.sqlite3" passes the URI check, so the canonical path must
-    // be validated too. Only the root-relative portion is checked so an app
-    // hosted under a "_"/"."-named directory is not blocked. The framework's
-    // own _route.wren (found only through the lstat-based route search) is
-    // exempt, and only when the resolved basename is exactly "_route.wren" so
-    // a planted sub/_route.wren -> ../_db.sqlite3 cannot waive the boundary.
-    int route_wren_waived = private_path_internal &&
-                            strcmp(path_basename(resolved_path), "_route.wren") == 0;
-    if(!route_wren_waived && has_forbidden_uri_component(resolved_path + root_len)) {
-      message(red("Security Error"), "Private file access blocked", path);
-      clean_http_message(hm);
-      custom_error(403, &response);
-      write_response(client_socket, &response);
-      free_response_owned(&response);
-      if(should_free_request)
-        free(full_request);
-      return;
+    c->fd = fd;
+    c->buf = buf;
+    c->cap = BUFFER_SIZE;
+    c->deadline = monotonic_ms() + BIALET_BODY_READ_DEADLINE_MS;
+#if IS_LINUX
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLET | EPOLLRDHUP,
+                             .data.ptr = c};
+    if(epoll_ctl(event_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      perror("epoll_ctl");
+      free(buf);
+      free(c);
+      socket_close(fd);
+      continue;
     }
-    // Use the verified resolved path
-    strncpy(path, resolved_path, PATH_SIZE - 1);
-    path[PATH_SIZE - 1] = '\0';
+#endif
+    c->next = connections;
+    if(connections)
+      connections->prev = c;
+    connections = c;
+    connection_count++;
   }
+}
 
-  // Open file and read content
-  FILE* file = open_file_within_root(path);
-  if(file == NULL) {
-    perror("Error opening file");
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
-  }
-  if(fseek(file, 0, SEEK_END) != 0) {
-    perror("fseek");
-    fclose(file);
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
+// Called once the header block is buffered. Reads Content-Length (anchored to
+// a line start, see find_header) and sizes the buffer for the whole request.
+// Returns 0 to keep reading, 1 when the request is ready, -1 on failure.
+static int connection_headers(struct Connection* c) {
+  // The name is passed without its colon: find_header requires the colon to
+  // be the byte immediately after the name.
+  static const char kContentLength[] = "Content-Length";
+  size_t            content_length = 0;
+  const char*       cl =
+      find_header(c->buf, c->hdr_len, kContentLength, sizeof(kContentLength) - 1);
+  if(cl != NULL) {
+    int rc = parse_content_length(cl, bialet_config.max_post_size, &content_length);
+    if(rc != 0) {
+      // Reject oversized or malformed bodies with a proper HTTP 413 instead
+      // of dropping the connection: reading the body into Wren would blow the
+      // memory limit. The already-declared body is drained first so the
+      // socket closes with a clean FIN and the client actually receives the
+      // 413 page.
+      c->rejected = 1;
+      size_t already = c->len - c->hdr_len;
+      size_t declared = 0;
+      if(rc > 0 && parse_content_length(cl, SIZE_MAX, &declared) == 0 &&
+         already < declared)
+        c->drain = declared - already;
+      return c->drain == 0 ? 1 : 0;
+    }
   }
-  long file_size_l = ftell(file);
-  if(file_size_l < 0) {
-    perror("ftell");
-    fclose(file);
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
+  c->full_size = c->hdr_len + content_length;
+  if(c->full_size + 1 > c->cap) {
+    char* grown = (char*)realloc(c->buf, c->full_size + 1);
+    if(grown == NULL) {
+      perror("Failed to allocate memory for large request");
+      return -1;
+    }
+    c->buf = grown;
+    c->cap = c->full_size + 1;
   }
-  size_t file_size = (size_t)file_size_l;
-  rewind(file);
+  return c->len >= c->full_size ? 1 : 0;
+}
 
-  // Only a genuine ".wren" suffix on the final component selects the
-  // interpreter. strstr(path, ".wren") matched the substring anywhere, so
-  // "/notes.wren.txt" and "/dir.wren/style.css" were both handed to the VM as
-  // source code.
-  unsigned char is_wren_file = 0;
-  {
-    const char* base = path_basename(path);
-    size_t      base_len = strlen(base);
-    if(base_len > BIALET_EXTENSION_LEN &&
-       strcmp(base + base_len - BIALET_EXTENSION_LEN, BIALET_EXTENSION) == 0) {
-      is_wren_file = 1;
+static int connection_write(struct Connection* c);
+
+// Serves every complete request in [c]'s buffer. A request is only answered
+// once the previous response is fully sent, which keeps pipelined responses
+// in order and bounds what a reader that never drains its socket can queue.
+// Returns 1 while the connection is open, 0 once it is gone.
+static int connection_advance(struct Connection* c) {
+  while(c->len > 0 && !c->rejected && c->out.head == NULL) {
+    int ready;
+    if(c->hdr_len == 0) {
+      c->hdr_len = header_block_len(c->buf, c->len);
+      if(c->hdr_len != 0)
+        ready = connection_headers(c);
+      else
+        ready = c->len >= BUFFER_SIZE - 1; // too large: served as received
+    } else {
+      ready = c->len >= c->full_size;
+    }
+    if(ready < 0) {
+      connection_drop(c);
+      return 0;
     }
+    if(!ready)
+      return 1;
+    if(!connection_dispatch(c))
+      return 0;
+    if(c->out.head != NULL)
+      return connection_write(c);
   }
+  return 1;
+}
 
-  // Always reserve room for a terminator, for wren and non-wren files alike.
-  // A zero-byte static file previously produced malloc(0), and the
-  // `length == 0 -> strlen(body)` fallback in write_response then read out of
-  // bounds to compute Content-Length and sent whatever heap bytes followed.
-  size_t alloc_size = file_size + 1;
-  char*  file_content = malloc(alloc_size);
-  if(file_content == NULL) {
-    perror("Error allocating memory for file content");
-    fclose(file);
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
+// Sends what is queued on [c] as its socket drains. Once the queue is empty
+// the connection is closed if the response asked for it, or goes on with the
+// requests buffered meanwhile. The deadline moves only when the reader took
+// something. Returns 1 while it is open, 0 once it is gone.
+static int connection_write(struct Connection* c) {
+  size_t queued = c->out.length;
+  int    flushed = output_flush(&c->out, c->fd);
+  if(flushed < 0 || (flushed > 0 && c->out.closing)) {
+    connection_drop(c);
+    return 0;
   }
-  size_t read_bytes = fread(file_content, 1, file_size, file);
-  if(read_bytes != file_size) {
-    perror("Error reading file");
-    free(file_content);
-    fclose(file);
-    clean_http_message(hm);
-    if(should_free_request)
-      free(full_request);
-    socket_close(client_socket);
-    return;
+  if(flushed == 0) {
+    if(c->out.length < queued)
+      c->deadline = monotonic_ms() + BIALET_SOCKET_TIMEOUT_MS;
+    return 1;
   }
-  fclose(file);
-  file_content[read_bytes] = '\0';
+  c->deadline = monotonic_ms() +
+                (c->len > 0 ? BIALET_BODY_READ_DEADLINE_MS : BIALET_KEEPALIVE_TIMEOUT_MS);
+  return connection_advance(c);
+}
 
-  if(is_wren_file) {
-    response = bialet_run(path, file_content, hm);
-    if(response.length == 0 && response.body) {
-      response.length = strlen(response.body);
+// Reads everything the socket has for [c] (edge-triggered: until EAGAIN) and
+// dispatches or drops the connection once its request is complete or broken.
+static void connection_read(struct Connection* c) {
+  char drain_buf[BUFFER_SIZE];
+  if(c->out.closing)
+    return; // nothing more is answered on it
+  for(;;) {
+    ssize_t n;
+    if(c->rejected) {
+      size_t want = c->drain < sizeof(drain_buf) ? c->drain : sizeof(drain_buf);
+      n = recv(c->fd, drain_buf, want, 0);
+      if(n > 0) {
+        c->drain -= (size_t)n;
+        if(c->drain == 0) {
+          connection_dispatch(c);
+          return;
+        }
+        continue;
+      }
+    } else {
+      // Header phase: fill the fixed header buffer. Body phase: read exactly
+      // up to the declared size.
+      size_t limit = c->hdr_len == 0 ? BUFFER_SIZE - 1 : c->full_size;
+      if(c->out.head != NULL && c->len >= limit)
+        return; // the next request waits for the current response to go out
+      if(c->len == 0 && c->out.head == NULL)
+        c->deadline = monotonic_ms() + BIALET_BODY_READ_DEADLINE_MS;
+      n = recv(c->fd, c->buf + c->len, limit - c->len, 0);
+      if(n > 0) {
+        c->len += (size_t)n;
+        if(!connection_advance(c))
+          return;
+        continue;
+      }
     }
-  } else {
-    response.status = 200;
-    response.body = file_content;
-    response.length = read_bytes;
-    response.header = get_content_type(path);
+    if(n < 0 && errno == EINTR)
+      continue;
+    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return; // wait for more bytes
+    // The peer closed or the socket failed. A rejected request still gets its
+    // 413, and a request cut short before the end of its header block is
+    // served as received (the blocking reader did the same); a truncated body
+    // is never processed.
+    if(n == 0 && c->out.head != NULL) {
+      c->out.closing = 1; // half-closed: finish the response, then close
+    } else if(c->rejected || (n == 0 && c->hdr_len == 0 && c->len > 0)) {
+      if(connection_dispatch(c))
+        connection_finish(c);
+    } else {
+      connection_drop(c);
+    }
+    return;
   }
+}
 
-  (void)livereload_inject_response(&response);
-  clean_http_message(hm);
-  write_response(client_socket, &response);
-  free(file_content);
-  free_response_owned(&response);
+// Drops every connection still open, on shutdown.
+static void connection_close_all(void) {
+  while(connections != NULL)
+    connection_drop(connections);
+#if IS_LINUX
+  if(event_fd >= 0) {
+    close(event_fd);
+    event_fd = -1;
+  }
+#endif
+}
 
-  // Free allocated memory if we had to read a large request
-  if(should_free_request)
-    free(full_request);
+// Connections past their deadline are answered the way the blocking reader
+// answered them: a partial header block is served, a rejected body gets its
+// 413, and an incomplete body is dropped. Idle keep-alive connections are
+// closed, and so are readers that took nothing of their response for
+// BIALET_SOCKET_TIMEOUT_MS. Writability is edge-triggered, and a send buffer
+// draining slowly may not signal it for a while, so a reader is given one
+// last write before it is dropped.
+static void connection_expire(long long now) {
+  struct Connection* c = connections;
+  while(c != NULL) {
+    struct Connection* next = c->next;
+    if(now >= c->deadline) {
+      if(c->out.head != NULL) {
+        if(connection_write(c) && c->deadline <= now)
+          connection_drop(c);
+      } else if(c->rejected || (c->hdr_len == 0 && c->len > 0)) {
+        if(connection_dispatch(c))
+          connection_finish(c);
+      } else {
+        connection_drop(c);
+      }
+    }
+    c = next;
+  }
 }
+#endif
 
 int server_poll(int delay) {
 #ifdef _WIN32
@@ -1044,12 +3127,80 @@ int server_poll(int delay) {
   } else if(ret == 0) {
     return 0;
   }
+
+  bialet_socket_t client_socket = accept(server_fd, NULL, NULL);
+  if(client_socket == BIALET_INVALID_SOCKET) {
+    perror("Failed to accept connection");
+    return -1;
+  }
+  set_socket_timeout(client_socket);
+  set_tcp_nodelay(client_socket);
+  handle_client(client_socket);
+
+  return 0;
+#else
+  // A worker may sit in poll()/epoll_wait() on a listener shared with other
+  // workers; a non-blocking listener makes the losers of an accept race get
+  // EAGAIN instead of blocking until the next connection.
+  static bialet_socket_t loop_listener = BIALET_INVALID_SOCKET;
+  if(loop_listener != server_fd) {
+    set_nonblocking(server_fd);
+#if IS_LINUX
+    if(event_fd < 0)
+      event_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(event_fd < 0) {
+      perror("epoll_create1");
+      return -1;
+    }
+    // The listener is level-triggered (data.ptr NULL marks it); connections
+    // are edge-triggered and always read until EAGAIN.
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = NULL};
+    if(epoll_ctl(event_fd, EPOLL_CTL_ADD, server_fd, &ev) != 0) {
+      perror("epoll_ctl");
+      return -1;
+    }
+#endif
+    loop_listener = server_fd;
+  }
+
+#if IS_LINUX
+  struct epoll_event events[BIALET_MAX_EVENTS];
+  int                ready = epoll_wait(event_fd, events, BIALET_MAX_EVENTS, delay);
+  if(ready < 0) {
+    // An interrupted wait is not an error: a shutdown signal lands here on its
+    // way to the poll loop, which previously logged "Poll error: Interrupted
+    // system call" on every clean Ctrl-C.
+    if(errno == EINTR)
+      return 0;
+    if(server_fd != BIALET_INVALID_SOCKET) {
+      perror("Poll error");
+    }
+    return -1;
+  }
+  for(int i = 0; i < ready; i++) {
+    struct Connection* c = (struct Connection*)events[i].data.ptr;
+    if(c == NULL) {
+      connection_accept();
+      continue;
+    }
+    if((events[i].events & EPOLLOUT) && c->out.head != NULL && !connection_write(c))
+      continue;
+    connection_read(c);
+  }
 #else
-  struct pollfd fds[1];
+  static struct pollfd     fds[BIALET_MAX_CONNECTIONS + 1];
+  static struct Connection* polled[BIALET_MAX_CONNECTIONS];
+  nfds_t                   nfds = 1;
   fds[0].fd = server_fd;
   fds[0].events = POLLIN;
+  for(struct Connection* c = connections; c != NULL; c = c->next) {
+    fds[nfds].fd = c->fd;
+    fds[nfds].events = c->out.head != NULL ? POLLIN | POLLOUT : POLLIN;
+    polled[nfds - 1] = c;
+    nfds++;
+  }
 
-  int poll_result = poll(fds, 1, delay);
+  int poll_result = poll(fds, nfds, delay);
   if(poll_result < 0) {
     // An interrupted wait is not an error: a shutdown signal lands here on its
     // way to the poll loop, which previously logged "Poll error: Interrupted
@@ -1060,24 +3211,22 @@ int server_poll(int delay) {
       perror("Poll error");
     }
     return -1;
-  } else if(poll_result == 0) {
-    return 0;
   }
-
-  if(!(fds[0].revents & POLLIN)) {
-    return 0;
+  for(nfds_t i = 1; i < nfds; i++) {
+    struct Connection* c = polled[i - 1];
+    if(fds[i].revents == 0)
+      continue;
+    if((fds[i].revents & POLLOUT) && c->out.head != NULL && !connection_write(c))
+      continue;
+    connection_read(c);
   }
+  if(fds[0].revents & POLLIN)
+    connection_accept();
 #endif
 
-  bialet_socket_t client_socket = accept(server_fd, NULL, NULL);
-  if(client_socket == BIALET_INVALID_SOCKET) {
-    perror("Failed to accept connection");
-    return -1;
-  }
-  set_socket_timeout(client_socket);
-  handle_client(client_socket);
-
+  connection_expire(monotonic_ms());
   return 0;
+#endif
 }
 
 static int custom_error_recursing = 0;
@@ -1087,6 +3236,7 @@ void custom_error(int status, struct BialetResponse* response) {
   // Response.useErrorFallback path in bialet_run swaps a real response for a
   // fallback page); release them before overwriting so they are not leaked.
   free_response_owned(response);
+  response->file_id = 0;
   response->header = BIALET_HEADERS;
   response->header_owned = 0;
   response->status = status;
@@ -14,6 +14,10 @@
 #include "bialet.h"
 
 int  start_server(struct BialetConfig* config);
+int  server_open_worker_listener();
+void server_remove_socket();
+void server_file_changed(const char* filepath);
+long server_files_generation();
 int  server_poll(int delay);
 void stop_server();
 void custom_error(int status, struct BialetResponse* response);
@@ -28,6 +32,7 @@ struct HttpMessage {
   struct String headers;
   struct String method;
   struct String routes;
+  // The raw request, borrowed from the buffer it was read into.
   struct String message;
 };
 
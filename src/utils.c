@@ -90,6 +90,155 @@ void trim(char* str) {
     memmove(str, start, strlen(start) + 1);
 }
 
+int hex_digit(char c) {
+  if(c >= '0' && c <= '9')
+    return c - '0';
+  if(c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  if(c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  return -1;
+}
+
+size_t url_decode(const char* input, size_t length, char* output) {
+  size_t out = 0;
+  for(size_t i = 0; i < length; i++) {
+    char c = input[i];
+    if(c == '%' && i + 2 < length) {
+      int high = hex_digit(input[i + 1]);
+      int low = hex_digit(input[i + 2]);
+      if(high >= 0 && low >= 0) {
+        output[out++] = (char)((high << 4) | low);
+        i += 2;
+        continue;
+      }
+    }
+    output[out++] = c == '+' ? ' ' : c;
+  }
+  return out;
+}
+
+// These used to be Wren loops in Util that built the result one character at a
+// time. The escaping ones only measure when [output] is NULL, so the caller can
+// allocate once, or keep the input when nothing changes.
+
+size_t html_escape(const char* input, size_t length, char* output,
+                   const char* apos) {
+  size_t apos_length = strlen(apos);
+  size_t out = 0;
+  for(size_t i = 0; i < length; i++) {
+    const char* entity;
+    size_t      entity_length;
+    switch(input[i]) {
+      case '&': entity = "&amp;"; entity_length = 5; break;
+      case '<': entity = "&lt;"; entity_length = 4; break;
+      case '>': entity = "&gt;"; entity_length = 4; break;
+      case '"': entity = "&quot;"; entity_length = 6; break;
+      case '\'': entity = apos; entity_length = apos_length; break;
+      default:
+        if(output != NULL)
+          output[out] = input[i];
+        out++;
+        continue;
+    }
+    if(output != NULL)
+      memcpy(output + out, entity, entity_length);
+    out += entity_length;
+  }
+  return out;
+}
+
+size_t url_encode(const char* input, size_t length, char* output) {
+  size_t out = 0;
+  for(size_t i = 0; i < length; i++) {
+    const char* code;
+    switch(input[i]) {
+      case '%': code = "%25"; break;
+      case '&': code = "%26"; break;
+      case '=': code = "%3D"; break;
+      case '?': code = "%3F"; break;
+      default:
+        if(output != NULL)
+          output[out] = input[i] == ' ' ? '+' : input[i];
+        out++;
+        continue;
+    }
+    if(output != NULL)
+      memcpy(output + out, code, 3);
+    out += 3;
+  }
+  return out;
+}
+
+size_t strip_control_chars(const char* input, size_t length, char* output) {
+  size_t out = 0;
+  for(size_t i = 0; i < length; i++) {
+    unsigned char c = (unsigned char)input[i];
+    if(c < 32 || c == 127)
+      continue;
+    if(output != NULL)
+      output[out] = (char)c;
+    out++;
+  }
+  return out;
+}
+
+static const char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+size_t base64_encode(const unsigned char* input, size_t length, char* output) {
+  size_t out = 0;
+  size_t i = 0;
+  for(; i + 2 < length; i += 3) {
+    output[out++] = base64_chars[input[i] >> 2];
+    output[out++] = base64_chars[((input[i] & 0x3) << 4) | (input[i + 1] >> 4)];
+    output[out++] =
+        base64_chars[((input[i + 1] & 0xF) << 2) | (input[i + 2] >> 6)];
+    output[out++] = base64_chars[input[i + 2] & 0x3F];
+  }
+  if(i < length) {
+    output[out++] = base64_chars[input[i] >> 2];
+    if(i + 1 == length) {
+      output[out++] = base64_chars[(input[i] & 0x3) << 4];
+      output[out++] = '=';
+    } else {
+      output[out++] = base64_chars[((input[i] & 0x3) << 4) | (input[i + 1] >> 4)];
+      output[out++] = base64_chars[(input[i + 1] & 0xF) << 2];
+    }
+    output[out++] = '=';
+  }
+  return out;
+}
+
+// Returns the value of the Base64 character [c], or -1.
+static int base64_digit(char c) {
+  const char* found = c != '\0' ? strchr(base64_chars, c) : NULL;
+  return found != NULL ? (int)(found - base64_chars) : -1;
+}
+
+int base64_decode(const char* input, size_t length, char* output,
+                  size_t* output_length) {
+  size_t out = 0;
+  if(length % 4 != 0)
+    return -1;
+  for(size_t i = 0; i < length; i += 4) {
+    int b1 = base64_digit(input[i]);
+    int b2 = base64_digit(input[i + 1]);
+    int b3 = base64_digit(input[i + 2]);
+    int b4 = base64_digit(input[i + 3]);
+    if(b1 < 0 || b2 < 0)
+      return -1;
+    output[out++] = (char)((b1 << 2) | (b2 >> 4));
+    if(b3 >= 0) {
+      output[out++] = (char)(((b2 & 0xF) << 4) | (b3 >> 2));
+      if(b4 >= 0)
+        output[out++] = (char)(((b3 & 0x3) << 6) | b4);
+    }
+  }
+  *output_length = out;
+  return 0;
+}
+
 #ifndef _WIN32
 // Walks [path] component by component with openat(O_NOFOLLOW) so a symlink
 // swap on any component between a realpath() containment check and this open
@@ -9,6 +9,37 @@ char* string_safe_copy(const char* zSrc);
 char* string_append(char* zPrior, const char* zSep, const char* zSrc);
 void  trim(char* str);
 
+// Decodes the URL-encoded [length] bytes at [input] ("%XX" and "+") into
+// [output], which must hold [length] bytes, and returns the decoded length. A
+// "%" without two hex digits is passed through as-is.
+size_t url_decode(const char* input, size_t length, char* output);
+
+// Returns the value of the hex digit [c], or -1.
+int hex_digit(char c);
+
+// The string helpers behind Util. Each writes the result for the [length]
+// bytes at [input] to [output] and returns its length. With a NULL [output]
+// they only return the length.
+
+// Replaces & < > " and ' with HTML entities, using [apos] for the quote.
+size_t html_escape(const char* input, size_t length, char* output,
+                   const char* apos);
+// Replaces " " with "+" and "%", "&", "=" and "?" with "%XX".
+size_t url_encode(const char* input, size_t length, char* output);
+// Drops the bytes below 32 and DEL.
+size_t strip_control_chars(const char* input, size_t length, char* output);
+
+// Standard Base64 with "=" padding. [output] must hold 4 * ((length + 2) / 3)
+// bytes and can not be NULL.
+size_t base64_encode(const unsigned char* input, size_t length, char* output);
+
+// Decodes [length] Base64 characters into [output], which must hold
+// 3 * length / 4 bytes. A group ends early at its first "=" (or any other
+// non-Base64 character) in the last two places. Returns -1 if [length] is not
+// a multiple of four or a group does not start with two Base64 characters.
+int base64_decode(const char* input, size_t length, char* output,
+                  size_t* output_length);
+
 // Opens [path] without following a symlink/junction in the final component.
 // On POSIX every component is walked with openat(O_NOFOLLOW); on Windows the
 // file is opened with FILE_FLAG_OPEN_REPARSE_POINT and reparse points are
@@ -106,9 +106,6 @@ typedef WrenForeignMethodFn (*WrenBindForeignMethodFn)(WrenVM*     vm,
 // Displays a string of text to the user.
 typedef void (*WrenWriteFn)(WrenVM* vm, const char* text);
 
-// Bialet integrated query
-typedef void (*WrenQueryFn)(WrenVM* vm, BialetQuery* query);
-
 typedef enum {
   // A syntax or resolution error detected at compile time.
   WREN_ERROR_COMPILE,
@@ -236,9 +233,6 @@ typedef struct {
   // errors.
   WrenErrorFn errorFn;
 
-  // Callback for integrated Bialet query
-  WrenQueryFn queryFn;
-
   // The number of bytes Wren will allocate before triggering the first garbage
   // collection.
   //
@@ -276,10 +270,21 @@ typedef struct {
   // User-defined data associated with the VM.
   void* userData;
 
+  // The data passed to [reallocateFn]. It used to be [userData], which the
+  // host is free to change with wrenSetUserData() while the VM is alive, so a
+  // custom allocator had nowhere stable to keep its state.
+  void* reallocateUserData;
+
   // When true, load test framework classes (Test, TestResponse).
   // Set this to true only when running tests with -T flag.
   bool enableTests;
 
+  // When true, the VM keeps the compiled function of every module it loads,
+  // keyed by the module name and a hash of its source. Loading the same
+  // source again, after the module was dropped from the registry, reuses the
+  // bytecode instead of compiling it. Only worth it for a long-lived VM.
+  bool enableModuleCache;
+
 } WrenConfiguration;
 
 typedef enum {
@@ -328,6 +333,9 @@ WREN_API void wrenFreeVM(WrenVM* vm);
 // Immediately run the garbage collector to free unused memory.
 WREN_API void wrenCollectGarbage(WrenVM* vm);
 
+// Drops every compiled module kept by [enableModuleCache].
+WREN_API void wrenClearModuleCache(WrenVM* vm);
+
 // Runs [source], a string of Wren source code in a new fiber in [vm] in the
 // context of resolved [module].
 WREN_API WrenInterpretResult wrenInterpret(WrenVM* vm, const char* module,
@@ -0,0 +1,414 @@
+#include "wren_bytecode.h"
+
+#include "wren_compiler.h"
+#include "wren_value.h"
+#include <string.h>
+
+// Bump when the layout below or the meaning of an opcode changes. A mismatch
+// makes the VM compile from source.
+#define BYTECODE_VERSION 1
+
+// The serialized form of a core module:
+//
+//   "WRNB" version sourceHash sourceLength symbols symbolsHash variables
+//   fn newSymbols newVariables
+//
+// [symbols] and [variables] are the sizes of the method table and of the core
+// module variables before the module was compiled, since the bytecode refers
+// to both by index. Integers are unsigned LEB128, numbers are the 8 bytes of
+// the double, least significant first.
+//
+// A fn is its maxSlots, numUpvalues, arity, name, code, the line of each
+// instruction as a delta from the previous one and its constants, each tagged
+// with one of these.
+typedef enum {
+  CONSTANT_NULL,
+  CONSTANT_NUM,
+  CONSTANT_STRING,
+  CONSTANT_QUERY,
+  CONSTANT_FN
+} ConstantType;
+
+WrenBytecodeCaptureFn wrenBytecodeCapture = NULL;
+
+static uint32_t hashBytes(uint32_t hash, const char* bytes, size_t length) {
+  // FNV-1a.
+  for(size_t i = 0; i < length; i++) {
+    hash ^= (uint8_t)bytes[i];
+    hash *= 16777619;
+  }
+  return hash;
+}
+
+// Hashes the names in the method table and in [module], so bytecode compiled
+// against a different set of primitives with the same count is not loaded.
+static uint32_t hashSymbols(WrenVM* vm, ObjModule* module) {
+  uint32_t hash = 2166136261u;
+  for(int i = 0; i < vm->methodNames.count; i++) {
+    ObjString* name = vm->methodNames.data[i];
+    hash = hashBytes(hash, name->value, name->length + 1);
+  }
+  for(int i = 0; i < module->variableNames.count; i++) {
+    ObjString* name = module->variableNames.data[i];
+    hash = hashBytes(hash, name->value, name->length + 1);
+  }
+  return hash;
+}
+
+static void writeInt(WrenVM* vm, ByteBuffer* out, uint32_t value) {
+  while(value >= 0x80) {
+    wrenByteBufferWrite(vm, out, (uint8_t)(value | 0x80));
+    value >>= 7;
+  }
+  wrenByteBufferWrite(vm, out, (uint8_t)value);
+}
+
+static void writeBytes(WrenVM* vm, ByteBuffer* out, const char* bytes,
+                       uint32_t length) {
+  writeInt(vm, out, length);
+  for(uint32_t i = 0; i < length; i++) {
+    wrenByteBufferWrite(vm, out, (uint8_t)bytes[i]);
+  }
+}
+
+static void writeNum(WrenVM* vm, ByteBuffer* out, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for(int i = 0; i < 8; i++) {
+    wrenByteBufferWrite(vm, out, (uint8_t)(bits >> (i * 8)));
+  }
+}
+
+static bool writeValue(WrenVM* vm, ByteBuffer* out, Value value);
+
+static bool writeFn(WrenVM* vm, ByteBuffer* out, ObjFn* fn) {
+  writeInt(vm, out, (uint32_t)fn->maxSlots);
+  writeInt(vm, out, (uint32_t)fn->numUpvalues);
+  writeInt(vm, out, (uint32_t)fn->arity);
+  writeBytes(vm, out, fn->debug->name, (uint32_t)strlen(fn->debug->name));
+  writeBytes(vm, out, (const char*)fn->code.data, (uint32_t)fn->code.count);
+
+  int line = 0;
+  writeInt(vm, out, (uint32_t)fn->debug->sourceLines.count);
+  for(int i = 0; i < fn->debug->sourceLines.count; i++) {
+    int32_t delta = fn->debug->sourceLines.data[i] - line;
+    writeInt(vm, out, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+    line = fn->debug->sourceLines.data[i];
+  }
+
+  writeInt(vm, out, (uint32_t)fn->constants.count);
+  for(int i = 0; i < fn->constants.count; i++) {
+    if(!writeValue(vm, out, fn->constants.data[i]))
+      return false;
+  }
+  return true;
+}
+
+static bool writeValue(WrenVM* vm, ByteBuffer* out, Value value) {
+  if(IS_NULL(value)) {
+    writeInt(vm, out, CONSTANT_NULL);
+  } else if(IS_NUM(value)) {
+    writeInt(vm, out, CONSTANT_NUM);
+    writeNum(vm, out, AS_NUM(value));
+  } else if(IS_STRING(value)) {
+    writeInt(vm, out, CONSTANT_STRING);
+    writeBytes(vm, out, AS_STRING(value)->value, AS_STRING(value)->length);
+  } else if(wrenIsObjType(value, OBJ_QUERY)) {
+    // Query literals are strings with their own type.
+    writeInt(vm, out, CONSTANT_QUERY);
+    writeBytes(vm, out, AS_STRING(value)->value, AS_STRING(value)->length);
+  } else if(IS_FN(value)) {
+    writeInt(vm, out, CONSTANT_FN);
+    return writeFn(vm, out, AS_FN(value));
+  } else {
+    // Nothing else is emitted as a constant by the compiler today.
+    return false;
+  }
+  return true;
+}
+
+// Serializes [fn], just compiled from [source] into [module], and hands it to
+// [wrenBytecodeCapture]. [symbols] and [variables] are the table sizes from
+// before the compile.
+static void captureCore(WrenVM* vm, const char* name, const char* source,
+                        ObjModule* module, ObjFn* fn, int symbols, int variables,
+                        uint32_t symbolsHash) {
+  ByteBuffer out;
+  wrenByteBufferInit(&out);
+
+  size_t length = strlen(source);
+  writeBytes(vm, &out, "WRNB", 4);
+  writeInt(vm, &out, BYTECODE_VERSION);
+  writeInt(vm, &out, hashBytes(2166136261u, source, length));
+  writeInt(vm, &out, (uint32_t)length);
+  writeInt(vm, &out, (uint32_t)symbols);
+  writeInt(vm, &out, symbolsHash);
+  writeInt(vm, &out, (uint32_t)variables);
+
+  bool ok = writeFn(vm, &out, fn);
+
+  writeInt(vm, &out, (uint32_t)(vm->methodNames.count - symbols));
+  for(int i = symbols; i < vm->methodNames.count; i++) {
+    ObjString* symbol = vm->methodNames.data[i];
+    writeBytes(vm, &out, symbol->value, symbol->length);
+  }
+
+  writeInt(vm, &out, (uint32_t)(module->variables.count - variables));
+  for(int i = variables; i < module->variables.count; i++) {
+    ObjString* variable = module->variableNames.data[i];
+    writeBytes(vm, &out, variable->value, variable->length);
+    ok = ok && writeValue(vm, &out, module->variables.data[i]);
+  }
+
+  if(ok)
+    wrenBytecodeCapture(name, out.data, (size_t)out.count);
+  else
+    wrenBytecodeCapture(name, NULL, 0);
+  wrenByteBufferClear(vm, &out);
+}
+
+typedef struct {
+  const uint8_t* data;
+  size_t         size;
+  size_t         offset;
+
+  // Set by the first read past the end or of something malformed. Reads after
+  // that return zeros.
+  bool error;
+} Reader;
+
+static uint32_t readInt(Reader* reader) {
+  uint32_t value = 0;
+  for(int shift = 0; shift < 35; shift += 7) {
+    if(reader->offset >= reader->size)
+      break;
+    uint8_t byte = reader->data[reader->offset++];
+    value |= (uint32_t)(byte & 0x7f) << shift;
+    if(!(byte & 0x80))
+      return value;
+  }
+  reader->error = true;
+  return 0;
+}
+
+// Reads a length prefixed run of bytes, storing its length in [length].
+static const char* readBytes(Reader* reader, uint32_t* length) {
+  *length = readInt(reader);
+  if(reader->error || *length > reader->size - reader->offset) {
+    reader->error = true;
+    *length = 0;
+    return "";
+  }
+  const char* bytes = (const char*)reader->data + reader->offset;
+  reader->offset += *length;
+  return bytes;
+}
+
+static double readNum(Reader* reader) {
+  if(reader->size - reader->offset < 8) {
+    reader->error = true;
+    return 0;
+  }
+  uint64_t bits = 0;
+  for(int i = 0; i < 8; i++) {
+    bits |= (uint64_t)reader->data[reader->offset++] << (i * 8);
+  }
+  double value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static ObjFn* readFn(WrenVM* vm, Reader* reader, ObjModule* module,
+                     ValueBuffer* parent);
+
+// Reads a tagged value. Nested fns are stored straight into [parent] so they
+// are reachable before anything else is allocated.
+static Value readValue(WrenVM* vm, Reader* reader, ObjModule* module,
+                       ValueBuffer* parent) {
+  uint32_t length;
+  const char* bytes;
+  switch(readInt(reader)) {
+    case CONSTANT_NULL:
+      return NULL_VAL;
+    case CONSTANT_NUM:
+      return NUM_VAL(readNum(reader));
+    case CONSTANT_STRING:
+      bytes = readBytes(reader, &length);
+      return wrenNewStringLength(vm, bytes, length);
+    case CONSTANT_QUERY:
+      bytes = readBytes(reader, &length);
+      return wrenNewQueryLength(vm, bytes, length);
+    case CONSTANT_FN:
+      if(parent != NULL) {
+        readFn(vm, reader, module, parent);
+        return UNDEFINED_VAL;
+      }
+      break;
+  }
+  reader->error = true;
+  return NULL_VAL;
+}
+
+static ObjFn* readFn(WrenVM* vm, Reader* reader, ObjModule* module,
+                     ValueBuffer* parent) {
+  int maxSlots = (int)readInt(reader);
+  ObjFn* fn = wrenNewFunction(vm, module, maxSlots);
+  if(parent != NULL)
+    parent->data[parent->count++] = OBJ_VAL(fn);
+  else
+    wrenPushRoot(vm, (Obj*)fn);
+
+  fn->numUpvalues = (int)readInt(reader);
+  fn->arity = (int)readInt(reader);
+
+  uint32_t length;
+  const char* bytes = readBytes(reader, &length);
+  wrenFunctionBindName(vm, fn, bytes, (int)length);
+
+  // Sized up front rather than written one element at a time: it is faster, and
+  // each constant is stored before the next allocation can trigger a GC.
+  bytes = readBytes(reader, &length);
+  if(length > 0) {
+    fn->code.data = ALLOCATE_ARRAY(vm, uint8_t, length);
+    fn->code.capacity = (int)length;
+    memcpy(fn->code.data, bytes, length);
+    fn->code.count = (int)length;
+  }
+
+  IntBuffer* lines = &fn->debug->sourceLines;
+  uint32_t count = readInt(reader);
+  if(count > reader->size - reader->offset) {
+    reader->error = true;
+    count = 0;
+  }
+  if(count > 0) {
+    lines->data = ALLOCATE_ARRAY(vm, int, count);
+    lines->capacity = (int)count;
+  }
+  int line = 0;
+  for(uint32_t i = 0; i < count; i++) {
+    uint32_t delta = readInt(reader);
+    line += (int32_t)(delta >> 1) ^ -(int32_t)(delta & 1);
+    lines->data[lines->count++] = line;
+  }
+
+  count = readInt(reader);
+  if(count > reader->size - reader->offset) {
+    reader->error = true;
+    count = 0;
+  }
+  if(count > 0) {
+    fn->constants.data = ALLOCATE_ARRAY(vm, Value, count);
+    fn->constants.capacity = (int)count;
+  }
+  for(uint32_t i = 0; i < count && !reader->error; i++) {
+    Value value = readValue(vm, reader, module, &fn->constants);
+    if(!IS_UNDEFINED(value))
+      fn->constants.data[fn->constants.count++] = value;
+  }
+
+  if(parent == NULL)
+    wrenPopRoot(vm);
+  return fn;
+}
+
+// Loads [bytecode] into [module], returning NULL when it was not built from
+// [source] against the current tables or is malformed. Nothing but garbage is
+// left behind in that case, so the caller can compile [source] instead.
+static ObjFn* loadCore(WrenVM* vm, ObjModule* module, const char* source,
+                       const uint8_t* bytecode, size_t size) {
+  Reader reader = {bytecode, size, 0, false};
+
+  uint32_t length;
+  const char* magic = readBytes(&reader, &length);
+  if(length != 4 || memcmp(magic, "WRNB", 4) != 0)
+    return NULL;
+  if(readInt(&reader) != BYTECODE_VERSION)
+    return NULL;
+
+  uint32_t sourceHash = readInt(&reader);
+  uint32_t sourceLength = readInt(&reader);
+  size_t actualLength = strlen(source);
+  if(sourceLength != actualLength ||
+     sourceHash != hashBytes(2166136261u, source, actualLength))
+    return NULL;
+
+  if(readInt(&reader) != (uint32_t)vm->methodNames.count)
+    return NULL;
+  if(readInt(&reader) != hashSymbols(vm, module))
+    return NULL;
+  if(readInt(&reader) != (uint32_t)module->variables.count)
+    return NULL;
+  if(reader.error)
+    return NULL;
+
+  ObjFn* fn = readFn(vm, &reader, module, NULL);
+  if(reader.error)
+    return NULL;
+
+  // Check the tables are well formed before anything is added to the VM.
+  wrenPushRoot(vm, (Obj*)fn);
+  size_t tables = reader.offset;
+  for(int table = 0; table < 2; table++) {
+    uint32_t count = readInt(&reader);
+    for(uint32_t i = 0; i < count && !reader.error; i++) {
+      readBytes(&reader, &length);
+      if(table == 1)
+        readValue(vm, &reader, module, NULL);
+    }
+  }
+  if(reader.error || reader.offset != size) {
+    wrenPopRoot(vm);
+    return NULL;
+  }
+
+  reader.offset = tables;
+  uint32_t count = readInt(&reader);
+  for(uint32_t i = 0; i < count; i++) {
+    const char* name = readBytes(&reader, &length);
+    wrenSymbolTableAdd(vm, &vm->methodNames, name, length);
+  }
+
+  count = readInt(&reader);
+  for(uint32_t i = 0; i < count; i++) {
+    const char* name = readBytes(&reader, &length);
+    Value value = readValue(vm, &reader, module, NULL);
+    wrenDefineVariable(vm, module, name, length, value, NULL);
+  }
+  wrenPopRoot(vm);
+
+  return fn;
+}
+
+WrenInterpretResult wrenInterpretCore(WrenVM* vm, const char* name,
+                                      const char* source, const uint8_t* bytecode,
+                                      size_t size) {
+  ObjModule* module = AS_MODULE(wrenMapGet(vm->modules, NULL_VAL));
+
+  ObjFn* fn = NULL;
+  if(bytecode != NULL && wrenBytecodeCapture == NULL)
+    fn = loadCore(vm, module, source, bytecode, size);
+
+  if(fn == NULL) {
+    int      symbols = vm->methodNames.count;
+    int      variables = module->variables.count;
+    uint32_t symbolsHash = hashSymbols(vm, module);
+
+    fn = wrenCompile(vm, module, source, false, true);
+    if(fn == NULL)
+      return WREN_RESULT_COMPILE_ERROR;
+
+    // Captured before running: binding methods patches the code in place.
+    if(wrenBytecodeCapture != NULL) {
+      wrenPushRoot(vm, (Obj*)fn);
+      captureCore(vm, name, source, module, fn, symbols, variables, symbolsHash);
+      wrenPopRoot(vm);
+    }
+  }
+
+  wrenPushRoot(vm, (Obj*)fn);
+  ObjClosure* closure = wrenNewClosure(vm, fn);
+  wrenPopRoot(vm); // fn.
+
+  return wrenInterpretClosure(vm, closure);
+}
@@ -0,0 +1,29 @@
+#ifndef wren_bytecode_h
+#define wren_bytecode_h
+
+#include "wren_vm.h"
+
+// Core modules (the Wren core, bialet and the test classes) used to be compiled
+// from source every time a VM was created, which is every request that does not
+// get the warm VM and every test run. tools/wren_precompile.c now compiles them
+// once at build time and serializes what the compiler produced, so a new VM only
+// has to rebuild the function objects.
+//
+// The bytecode records a hash of the source it was built from and the method
+// and core variable tables it was compiled against. When any of those does not
+// match (an edited .wren file, a build without the generated bytecode) the
+// module is compiled from [source] as before.
+
+// Called with the bytecode for each core module compiled from source, when set.
+typedef void (*WrenBytecodeCaptureFn)(const char* name, const uint8_t* data,
+                                      size_t size);
+
+extern WrenBytecodeCaptureFn wrenBytecodeCapture;
+
+// Runs the core module [name], loading it from [bytecode] when that was built
+// from [source] and compiling [source] otherwise.
+WrenInterpretResult wrenInterpretCore(WrenVM* vm, const char* name,
+                                      const char* source, const uint8_t* bytecode,
+                                      size_t size);
+
+#endif
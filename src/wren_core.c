@@ -8,6 +8,9 @@
 #include "http_call.h"
 #include "json.h"
 #include "markdown.h"
+#include "query_cache.h"
+#include "utils.h"
+#include "wren_bytecode.h"
 #include "wren_core.wren.inc"
 #include "wren_math.h"
 #include "wren_primitive.h"
@@ -22,6 +25,15 @@
 #include <string.h>
 #include <time.h>
 
+// The bytecode tools/wren_precompile.c generates from the sources above. Builds
+// without it (cross compiles, the precompiler itself) compile the sources.
+#ifdef WREN_PRECOMPILED_CORE
+#include "wren_core.bytecode.inc"
+#define CORE_BYTECODE(module) module##ModuleBytecode, sizeof(module##ModuleBytecode)
+#else
+#define CORE_BYTECODE(module) NULL, 0
+#endif
+
 DEF_PRIMITIVE(bool_not) {
   RETURN_BOOL(!AS_BOOL(args[0]));
 }
@@ -632,6 +644,10 @@ DEF_PRIMITIVE(null_toString) {
 }
 
 DEF_PRIMITIVE(num_fromString) {
+  // Query results used to be all strings, so apps convert numeric columns
+  // with Num.fromString. Those columns are numbers now and pass through.
+  if(IS_NUM(args[1]))
+    RETURN_VAL(args[1]);
   if(!validateString(vm, args[1], "Argument"))
     return false;
 
@@ -1215,6 +1231,72 @@ DEF_PRIMITIVE(string_toString) {
   RETURN_VAL(args[0]);
 }
 
+DEF_PRIMITIVE(stringBuilder_new) {
+  RETURN_VAL(wrenNewStringBuilder(vm));
+}
+
+DEF_PRIMITIVE(stringBuilder_append) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+
+  ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+  ObjString*        string = AS_STRING(args[1]);
+  if(string->length == 0)
+    RETURN_VAL(args[0]);
+  if(!wrenStringBuilderReserve(vm, builder, string->length))
+    RETURN_ERROR("String too long.");
+
+  memcpy(builder->value + builder->length, string->value, string->length);
+  builder->length += string->length;
+  RETURN_VAL(args[0]);
+}
+
+DEF_PRIMITIVE(stringBuilder_appendHtml) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+
+  ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+  ObjString*        string = AS_STRING(args[1]);
+
+  // Measured first so the buffer grows once.
+  size_t length = html_escape(string->value, string->length, NULL, "&apos;");
+  if(length == 0)
+    RETURN_VAL(args[0]);
+  if(!wrenStringBuilderReserve(vm, builder, length))
+    RETURN_ERROR("String too long.");
+
+  html_escape(string->value, string->length, builder->value + builder->length,
+              "&apos;");
+  builder->length += (uint32_t)length;
+  RETURN_VAL(args[0]);
+}
+
+DEF_PRIMITIVE(stringBuilder_byteCount) {
+  RETURN_NUM(AS_STRING_BUILDER(args[0])->length);
+}
+
+DEF_PRIMITIVE(stringBuilder_clear) {
+  AS_STRING_BUILDER(args[0])->length = 0;
+  RETURN_VAL(args[0]);
+}
+
+DEF_PRIMITIVE(stringBuilder_toString) {
+  ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+  RETURN_VAL(wrenNewStringLength(vm, builder->value, builder->length));
+}
+
+// The first [count] bytes written, which stay the same however much is
+// appended later.
+DEF_PRIMITIVE(stringBuilder_toStringCount) {
+  ObjStringBuilder* builder = AS_STRING_BUILDER(args[0]);
+  if(!validateInt(vm, args[1], "Count"))
+    return false;
+  double count = AS_NUM(args[1]);
+  if(count < 0 || count > builder->length)
+    RETURN_ERROR("Count out of bounds.");
+  RETURN_VAL(wrenNewStringLength(vm, builder->value, (size_t)count));
+}
+
 DEF_PRIMITIVE(system_clock) {
   RETURN_NUM((double)clock() / CLOCKS_PER_SEC);
 }
@@ -1290,17 +1372,6 @@ DEF_PRIMITIVE(util_randomString) {
   RETURN_VAL(result);
 }
 
-// Returns the hex value of [c], or -1 if it is not a hex digit.
-static int urlHexDigit(char c) {
-  if(c >= '0' && c <= '9')
-    return c - '0';
-  if(c >= 'a' && c <= 'f')
-    return c - 'a' + 10;
-  if(c >= 'A' && c <= 'F')
-    return c - 'A' + 10;
-  return -1;
-}
-
 // Decodes a URL-encoded string in a single allocation. The previous Wren
 // implementation iterated str.count (an O(n) Sequence walk) once per
 // character, making decoding quadratic on attacker-controlled query/body
@@ -1308,40 +1379,194 @@ static int urlHexDigit(char c) {
 // byte, "+" -> one byte, everything else passes through), so the input
 // length is a safe upper bound for the output buffer.
 DEF_PRIMITIVE(util_urlDecode) {
-  ObjString*  string = AS_STRING(args[1]);
-  uint32_t    length = string->length;
-  const char* input = string->value;
+  ObjString* string = AS_STRING(args[1]);
 
-  char* buffer = malloc((size_t)length + 1);
+  char* buffer = malloc((size_t)string->length + 1);
   if(buffer == NULL)
     RETURN_ERROR("Out of memory decoding URL string.");
 
-  size_t out = 0;
-  for(uint32_t i = 0; i < length; i++) {
-    char c = input[i];
-    if(c == '%' && i + 2 < length) {
-      int high = urlHexDigit(input[i + 1]);
-      int low = urlHexDigit(input[i + 2]);
-      if(high >= 0 && low >= 0) {
-        buffer[out++] = (char)((high << 4) | low);
-        i += 2;
-        continue;
-      }
-    }
+  size_t out = url_decode(string->value, string->length, buffer);
+  Value  result = wrenNewStringLength(vm, buffer, out);
+  free(buffer);
+  RETURN_VAL(result);
+}
 
-    // A trailing '%' or one without two hex digits is passed through as-is.
-    if(c == '+') {
-      buffer[out++] = ' ';
-    } else {
-      buffer[out++] = c;
-    }
+// Returns [string] with [filter] from utils.c applied, or [string] itself when
+// the filter keeps its length, which for these means nothing changed.
+static Value utilFilter(WrenVM* vm, ObjString* string, size_t length,
+                        size_t (*filter)(const char*, size_t, char*)) {
+  if(length == string->length)
+    return OBJ_VAL(string);
+
+  char* buffer = malloc(length > 0 ? length : 1);
+  if(buffer == NULL)
+    return NULL_VAL;
+  filter(string->value, string->length, buffer);
+  Value result = wrenNewStringLength(vm, buffer, length);
+  free(buffer);
+  return result;
+}
+
+static size_t utilHtmlEscape(const char* input, size_t length, char* output) {
+  return html_escape(input, length, output, "&#x27;");
+}
+
+DEF_PRIMITIVE(util_htmlEscape) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+  size_t     length = utilHtmlEscape(string->value, string->length, NULL);
+  Value      result = utilFilter(vm, string, length, utilHtmlEscape);
+  if(IS_NULL(result))
+    RETURN_ERROR("Out of memory escaping string.");
+  RETURN_VAL(result);
+}
+
+DEF_PRIMITIVE(util_stripControlChars) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+  size_t     length = strip_control_chars(string->value, string->length, NULL);
+  Value      result = utilFilter(vm, string, length, strip_control_chars);
+  if(IS_NULL(result))
+    RETURN_ERROR("Out of memory stripping string.");
+  RETURN_VAL(result);
+}
+
+// stripControlChars followed by trim(). Tabs and line breaks are gone by
+// then, so only spaces are left to trim.
+DEF_PRIMITIVE(util_headerValue) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+
+  char* buffer = malloc(string->length > 0 ? string->length : 1);
+  if(buffer == NULL)
+    RETURN_ERROR("Out of memory stripping string.");
+  size_t length = strip_control_chars(string->value, string->length, buffer);
+  size_t start = 0;
+  while(start < length && buffer[start] == ' ')
+    start++;
+  while(length > start && buffer[length - 1] == ' ')
+    length--;
+
+  Value result = start == 0 && length == string->length
+                     ? args[1]
+                     : wrenNewStringLength(vm, buffer + start, length - start);
+  free(buffer);
+  RETURN_VAL(result);
+}
+
+DEF_PRIMITIVE(util_urlEncode) {
+  if(!validateString(vm, args[1], "Value"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+
+  size_t length = url_encode(string->value, string->length, NULL);
+  char*  buffer = malloc(length > 0 ? length : 1);
+  if(buffer == NULL)
+    RETURN_ERROR("Out of memory encoding URL string.");
+  url_encode(string->value, string->length, buffer);
+  Value result = wrenNewStringLength(vm, buffer, length);
+  free(buffer);
+  RETURN_VAL(result);
+}
+
+// Characters that are not hex digits count as 0 but still take their place.
+DEF_PRIMITIVE(util_hexToDec) {
+  if(!validateString(vm, args[1], "Hex string"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+
+  double decimal = 0;
+  double base = 1;
+  for(uint32_t i = string->length; i > 0; i--) {
+    int digit = hex_digit(string->value[i - 1]);
+    decimal = decimal + (digit < 0 ? 0 : digit) * base;
+    base = base * 16;
+  }
+  RETURN_NUM(decimal);
+}
+
+// Uppercase and without leading zeros, so 0 and negative numbers give "".
+DEF_PRIMITIVE(util_toHex) {
+  if(!validateNum(vm, args[1], "Byte"))
+    return false;
+
+  double byte = AS_NUM(args[1]);
+  char   hex[16];
+  int    start = (int)sizeof(hex);
+  while(byte > 0) {
+    double digit = fmod(byte, 16);
+    if(trunc(digit) != digit)
+      RETURN_ERROR("Byte must be an integer.");
+    hex[--start] = "0123456789ABCDEF"[(int)digit];
+    // Shifted as a 32-bit integer, the same as `>>` does.
+    byte = (double)((uint32_t)fmod(byte, 4294967296.0) >> 4);
   }
+  RETURN_VAL(wrenNewStringLength(vm, hex + start, sizeof(hex) - (size_t)start));
+}
 
-  Value result = wrenNewStringLength(vm, buffer, out);
+DEF_PRIMITIVE(util_encodeBase64) {
+  if(!validateString(vm, args[1], "Input"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+
+  size_t length = 4 * (((size_t)string->length + 2) / 3);
+  char*  buffer = malloc(length > 0 ? length : 1);
+  if(buffer == NULL)
+    RETURN_ERROR("Out of memory encoding Base64 string.");
+  base64_encode((const unsigned char*)string->value, string->length, buffer);
+  Value result = wrenNewStringLength(vm, buffer, length);
   free(buffer);
   RETURN_VAL(result);
 }
 
+DEF_PRIMITIVE(util_decodeBase64) {
+  if(!validateString(vm, args[1], "Input"))
+    return false;
+  ObjString* string = AS_STRING(args[1]);
+
+  char* buffer = malloc(string->length > 0 ? string->length : 1);
+  if(buffer == NULL)
+    RETURN_ERROR("Out of memory decoding Base64 string.");
+  size_t length;
+  if(base64_decode(string->value, string->length, buffer, &length) != 0) {
+    free(buffer);
+    RETURN_NULL;
+  }
+  Value result = wrenNewStringLength(vm, buffer, length);
+  free(buffer);
+  RETURN_VAL(result);
+}
+
+// The request body and uploads are read from the raw message in
+// bialet_wren.c, only when the handler asks for them.
+DEF_PRIMITIVE(request_body) {
+  extern Value bialet_request_body(WrenVM* vm);
+  Value body = bialet_request_body(vm);
+  if(IS_NULL(body))
+    RETURN_ERROR("Out of memory reading the request body.");
+  RETURN_VAL(body);
+}
+
+DEF_PRIMITIVE(request_form) {
+  if(!validateString(vm, args[1], "Body"))
+    return false;
+  extern Value bialet_request_form(WrenVM* vm, ObjString* body);
+  Value form = bialet_request_form(vm, AS_STRING(args[1]));
+  if(IS_NULL(form))
+    RETURN_ERROR("Out of memory decoding the request form.");
+  RETURN_VAL(form);
+}
+
+DEF_PRIMITIVE(request_upload) {
+  if(!validateString(vm, args[1], "Name"))
+    return false;
+  extern Value bialet_request_upload(WrenVM* vm, ObjString* name);
+  RETURN_VAL(bialet_request_upload(vm, AS_STRING(args[1])));
+}
+
 // Builds a default page from the shared C-side template (BIALET_HEADER_PAGE /
 // BIALET_FOOTER_PAGE). This is the single source of truth for the default page
 // chrome; Wren's Response.page/pageHtml call this instead of redefining the
@@ -1402,7 +1627,13 @@ DEF_PRIMITIVE(http_call) {
 
   http_call_perform(&request, &response);
 
+  // The strings may start a collection, which has to find the list rooted and
+  // with no garbage in its elements.
   ObjList* res = wrenNewList(vm, 5);
+  for(int i = 0; i < 5; i++) {
+    res->elements.data[i] = NULL_VAL;
+  }
+  wrenPushRoot(vm, (Obj*)res);
   res->elements.data[0] = NUM_VAL(response.status);
   res->elements.data[1] =
       wrenNewString(vm, response.headers ? response.headers : "");
@@ -1410,6 +1641,7 @@ DEF_PRIMITIVE(http_call) {
   res->elements.data[3] = NUM_VAL(response.error);
   res->elements.data[4] =
       wrenNewString(vm, response.error_message ? response.error_message : "");
+  wrenPopRoot(vm);
 
   // http_call_perform heap-allocates the body/headers (curl chunk copies,
   // or the Windows parse_http_response buffers); release them now that the
@@ -1544,13 +1776,17 @@ DEF_PRIMITIVE(test_runRequest) {
   // Return [status, body, headers_string]
   ObjList* res = wrenNewList(vm, 3);
   res->elements.data[0] = NUM_VAL(response.status);
-  res->elements.data[1] =
-      OBJ_VAL(wrenNewString(vm, response.body ? response.body : ""));
+  // The body may point into a string of the warm VM, which is not
+  // terminated where the body ends.
+  const char* body = response.body ? response.body : "";
+  res->elements.data[1] = wrenNewStringLength(
+      vm, body, response.length > 0 ? response.length : strlen(body));
   res->elements.data[2] =
       OBJ_VAL(wrenNewString(vm, response.header ? response.header : ""));
 
   // Free response data (respect ownership flags: error fallback pages are
   // static strings and must not be freed).
+  bialet_response_release(&response);
   if(response.body_owned)
     free(response.body);
   if(response.header_owned)
@@ -1802,104 +2038,526 @@ DEF_PRIMITIVE(markdown_file) {
   RETURN_VAL(result);
 };
 
-// Binds each parameter in [params] to [query]. Returns false (and sets a
-// fiber error) when a parameter has a type the native layer cannot bind, so a
-// parameter is never dropped silently: that would shift every later `?`
-// placeholder left and corrupt the row. The Wren layer stringifies
+// Binds each parameter in [params] to [stmt] straight from its value. Returns
+// false (and sets a fiber error) when a parameter has a type the native layer
+// cannot bind, so a parameter is never dropped silently: that would shift every
+// later `?` placeholder left and corrupt the row. The Wren layer stringifies
 // non-primitives (HtmlNode, Date, ...) via toString before calling in, so a
 // failure here means a caller bypassed that and passed an unsupported type.
-static bool queryPrepare(WrenVM* vm, BialetQuery* query, ObjList* params) {
-  Value val;
-  if(vm->config.writeFn != NULL) {
-    for(int i = 0; i < params->elements.count; i++) {
-      val = params->elements.data[i];
-      int ok = 0;
-      if(IS_NULL(val)) {
-        ok = add_parameter(query, 0, BIALETQUERYTYPE_NULL);
-      } else if(IS_BOOL(val)) {
-        ok = add_parameter(query, AS_BOOL(val) ? "1" : "0", BIALETQUERYTYPE_BOOLEAN);
-      } else if(IS_NUM(val)) {
-        char num[MAX_NUMBER_LENGTH];
-        // %.17g keeps full double precision and renders compactly (DBL_MAX
-        // is ~24 chars); %f expands to hundreds of chars and overflowed
-        // this fixed stack buffer.
-        int written = snprintf(num, sizeof(num), "%.17g", AS_NUM(val));
-        if(written < 0 || written >= (int)sizeof(num)) {
-          vm->fiber->error = wrenStringFormat(
-              vm, "Query parameter %d does not fit in a number buffer", i + 1);
-          return false;
-        }
-        ok = add_parameter(query, num, BIALETQUERYTYPE_NUMBER);
-      } else if(IS_STRING(val)) {
-        ok = add_parameter(query, AS_CSTRING(val), BIALETQUERYTYPE_STRING);
+//
+// Parameters used to be formatted as text and parsed back before binding. Now
+// whole numbers bind as integers, other numbers as doubles, and strings are
+// bound in place, as [params] keeps them alive until the statement is released.
+static bool queryBind(WrenVM* vm, sqlite3_stmt* stmt, ObjList* params) {
+  for(int i = 0; i < params->elements.count; i++) {
+    Value val = params->elements.data[i];
+    if(IS_NULL(val)) {
+      sqlite3_bind_null(stmt, i + 1);
+    } else if(IS_BOOL(val)) {
+      sqlite3_bind_int(stmt, i + 1, AS_BOOL(val) ? 1 : 0);
+    } else if(IS_NUM(val)) {
+      double num = AS_NUM(val);
+      if(num == trunc(num) && num >= -9223372036854775808.0 &&
+         num < 9223372036854775808.0) {
+        sqlite3_bind_int64(stmt, i + 1, (sqlite3_int64)num);
       } else {
-        vm->fiber->error = wrenStringFormat(
-            vm,
-            "Unsupported query parameter type @; only null, bool, num and "
-            "string are bindable. Stringify values with toString() first.",
-            OBJ_VAL(wrenGetClass(vm, val)->name));
-        return false;
+        sqlite3_bind_double(stmt, i + 1, num);
       }
-      // On allocation failure, drop the parameter instead of dereferencing
-      // the un-grown array in the query runner.
-      if(ok != 0)
-        continue;
+    } else if(IS_STRING(val)) {
+      ObjString* string = AS_STRING(val);
+      sqlite3_bind_text(stmt, i + 1, string->value, (int)string->length,
+                        SQLITE_STATIC);
+    } else {
+      vm->fiber->error = wrenStringFormat(
+          vm,
+          "Unsupported query parameter type @; only null, bool, num and "
+          "string are bindable. Stringify values with toString() first.",
+          OBJ_VAL(wrenGetClass(vm, val)->name));
+      return false;
     }
-    vm->config.queryFn(vm, query);
   }
   return true;
 }
 
+// The column names of [stmt], made once per statement and shared as the keys
+// of every row.
+static ObjList* queryColumns(WrenVM* vm, sqlite3_stmt* stmt) {
+  int      count = sqlite3_column_count(stmt);
+  ObjList* columns = wrenNewList(vm, count);
+  for(int i = 0; i < count; i++) {
+    columns->elements.data[i] = NULL_VAL;
+  }
+  wrenPushRoot(vm, (Obj*)columns);
+  for(int i = 0; i < count; i++) {
+    const char* name = sqlite3_column_name(stmt, i);
+    columns->elements.data[i] = wrenNewString(vm, name != NULL ? name : "");
+  }
+  wrenPopRoot(vm);
+  return columns;
+}
+
+// The value in column [i] of the current row. Integers and reals are numbers,
+// NULL is null, and text and blobs are strings with their bytes as stored.
+static Value queryColumn(WrenVM* vm, sqlite3_stmt* stmt, int i) {
+  switch(sqlite3_column_type(stmt, i)) {
+    case SQLITE_INTEGER:
+      return NUM_VAL((double)sqlite3_column_int64(stmt, i));
+    case SQLITE_FLOAT:
+      return NUM_VAL(sqlite3_column_double(stmt, i));
+    case SQLITE_TEXT:
+    case SQLITE_BLOB: {
+      const char* data = sqlite3_column_type(stmt, i) == SQLITE_TEXT
+                             ? (const char*)sqlite3_column_text(stmt, i)
+                             : (const char*)sqlite3_column_blob(stmt, i);
+      // Empty blobs (and failed text conversions) come back as NULL.
+      if(data == NULL)
+        return wrenNewStringLength(vm, "", 0);
+      return wrenNewStringLength(vm, data, sqlite3_column_bytes(stmt, i));
+    }
+    default:
+      return NULL_VAL;
+  }
+}
+
+// Sets the current row of [stmt] in [row], keyed by [columns]. A map that
+// already held a row of the same statement keeps its entries and only has the
+// values replaced.
+static void queryFillRow(WrenVM* vm, sqlite3_stmt* stmt, ObjList* columns,
+                         ObjMap* row) {
+  wrenPushRoot(vm, (Obj*)row);
+  for(int i = 0; i < columns->elements.count; i++) {
+    Value value = queryColumn(vm, stmt, i);
+    if(IS_OBJ(value))
+      wrenPushRoot(vm, AS_OBJ(value));
+    wrenMapSet(vm, row, columns->elements.data[i], value);
+    if(IS_OBJ(value))
+      wrenPopRoot(vm);
+  }
+  wrenPopRoot(vm);
+}
+
+// Builds a map from the current row of [stmt], keyed by [columns].
+static Value queryRow(WrenVM* vm, sqlite3_stmt* stmt, ObjList* columns) {
+  ObjMap* row = wrenNewMap(vm);
+  queryFillRow(vm, stmt, columns, row);
+  return OBJ_VAL(row);
+}
+
 DEF_PRIMITIVE(query_fetch) {
-  BialetQuery* query = create_bialet_query();
-  if(query == NULL)
-    RETURN_ERROR("Out of memory allocating query");
-  char* qs = strdup(AS_CSTRING(args[1]));
-  if(qs == NULL) {
-    free_bialet_query(query);
-    RETURN_ERROR("Out of memory allocating query string");
-  }
-  query->queryString = qs;
-  if(!queryPrepare(vm, query, AS_LIST(args[2]))) {
-    free_bialet_query(query);
-    return false;
-  }
-  ObjList* list = wrenNewList(vm, query->resultsCount);
-  for(int i = 0; i < query->resultsCount; i++) {
-    ObjMap*           row = wrenNewMap(vm);
-    BialetQueryResult res = query->results[i];
-    for(int j = 0; j < res.rowCount; j++) {
-      wrenMapSet(vm, row, wrenNewString(vm, res.rows[j].name),
-                 wrenNewStringLength(vm, res.rows[j].value, res.rows[j].size));
+  sqlite3_stmt* stmt = bialet_query_prepare(AS_CSTRING(args[1]));
+  if(stmt == NULL)
+    RETURN_OBJ(wrenNewList(vm, 0));
+  if(!queryBind(vm, stmt, AS_LIST(args[2]))) {
+    bialet_query_release(stmt, SQLITE_OK);
+    return false;
+  }
+
+  ObjList* rows = wrenNewList(vm, 0);
+  wrenPushRoot(vm, (Obj*)rows);
+  ObjList* columns = NULL;
+  int      result;
+  while((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    if(columns == NULL) {
+      columns = queryColumns(vm, stmt);
+      wrenPushRoot(vm, (Obj*)columns);
     }
-    list->elements.data[i] = OBJ_VAL(row);
+    wrenListInsert(vm, rows, queryRow(vm, stmt, columns), rows->elements.count);
   }
-  free_bialet_query(query);
-  RETURN_OBJ(list);
+  if(columns != NULL)
+    wrenPopRoot(vm);
+  wrenPopRoot(vm);
+  bialet_query_release(stmt, result);
+  RETURN_OBJ(rows);
+}
+
+// The first row of the query as text, each column as SQLite writes it and NULL
+// as empty, or null when there is no row. Built from the typed values, a large
+// integer or a real such as 3.0 would come back rounded or reformatted.
+DEF_PRIMITIVE(query_val) {
+  sqlite3_stmt* stmt = bialet_query_prepare(AS_CSTRING(args[1]));
+  if(stmt == NULL)
+    RETURN_NULL;
+  if(!queryBind(vm, stmt, AS_LIST(args[2]))) {
+    bialet_query_release(stmt, SQLITE_OK);
+    return false;
+  }
+
+  int result = sqlite3_step(stmt);
+  if(result != SQLITE_ROW) {
+    bialet_query_release(stmt, result);
+    RETURN_NULL;
+  }
+  int    count = sqlite3_column_count(stmt);
+  size_t length = 0;
+  for(int i = 0; i < count; i++) {
+    if(sqlite3_column_type(stmt, i) != SQLITE_NULL && sqlite3_column_text(stmt, i) != NULL)
+      length += (size_t)sqlite3_column_bytes(stmt, i);
+  }
+  char* text = malloc(length > 0 ? length : 1);
+  if(text == NULL) {
+    bialet_query_release(stmt, SQLITE_OK);
+    RETURN_ERROR("Out of memory reading a query value.");
+  }
+  size_t at = 0;
+  for(int i = 0; i < count; i++) {
+    const char* column = sqlite3_column_type(stmt, i) != SQLITE_NULL
+                             ? (const char*)sqlite3_column_text(stmt, i)
+                             : NULL;
+    if(column == NULL)
+      continue;
+    size_t bytes = (size_t)sqlite3_column_bytes(stmt, i);
+    memcpy(text + at, column, bytes);
+    at += bytes;
+  }
+  // The rest of a statement without a LIMIT (an UPDATE ... RETURNING) still runs.
+  while((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+  }
+  bialet_query_release(stmt, result);
+  Value value = wrenNewStringLength(vm, text, at);
+  free(text);
+  RETURN_VAL(value);
+}
+
+// [num] as text with every digit: whole numbers in the int64 range as
+// integers, others in the shortest form that reads back as the same number.
+DEF_PRIMITIVE(query_numText) {
+  if(!validateNum(vm, args[1], "Value"))
+    return false;
+  double num = AS_NUM(args[1]);
+  char   text[32];
+  if(num == trunc(num) && num >= -9223372036854775808.0 && num < 9223372036854775808.0) {
+    snprintf(text, sizeof(text), "%lld", (long long)num);
+  } else {
+    for(int precision = 15; precision <= 17; precision++) {
+      snprintf(text, sizeof(text), "%.*g", precision, num);
+      if(strtod(text, NULL) == num)
+        break;
+    }
+  }
+  RETURN_VAL(wrenNewString(vm, text));
+}
+
+// The key a cached query is stored under: the SQL, then the type and the bytes
+// of each parameter. NULL when a parameter could not be bound anyway.
+static char* queryCacheKey(ObjString* sql, ObjList* params, size_t* length) {
+  size_t size = sql->length + 1;
+  for(int i = 0; i < params->elements.count; i++) {
+    Value val = params->elements.data[i];
+    if(IS_NUM(val)) {
+      size += 1 + sizeof(double);
+    } else if(IS_STRING(val)) {
+      size += 1 + sizeof(uint32_t) + AS_STRING(val)->length;
+    } else if(IS_NULL(val) || IS_BOOL(val)) {
+      size += 1;
+    } else {
+      return NULL;
+    }
+  }
+
+  char* key = malloc(size);
+  if(key == NULL)
+    return NULL;
+  memcpy(key, sql->value, sql->length + 1);
+  char* at = key + sql->length + 1;
+  for(int i = 0; i < params->elements.count; i++) {
+    Value val = params->elements.data[i];
+    if(IS_NUM(val)) {
+      double num = AS_NUM(val);
+      *at++ = 'n';
+      memcpy(at, &num, sizeof(double));
+      at += sizeof(double);
+    } else if(IS_STRING(val)) {
+      uint32_t bytes = AS_STRING(val)->length;
+      *at++ = 's';
+      memcpy(at, &bytes, sizeof(uint32_t));
+      memcpy(at + sizeof(uint32_t), AS_STRING(val)->value, bytes);
+      at += sizeof(uint32_t) + bytes;
+    } else if(IS_BOOL(val)) {
+      *at++ = AS_BOOL(val) ? 't' : 'f';
+    } else {
+      *at++ = '0';
+    }
+  }
+  *length = size;
+  return key;
+}
+
+// Appends a value made by queryColumn() to [result].
+static int queryCacheAdd(struct QueryCacheResult* result, Value value) {
+  if(IS_NUM(value))
+    return query_cache_result_add_num(result, AS_NUM(value));
+  if(IS_STRING(value))
+    return query_cache_result_add_string(result, AS_STRING(value)->value,
+                                         AS_STRING(value)->length);
+  return query_cache_result_add_null(result);
+}
+
+static Value queryCacheValue(WrenVM* vm, const struct QueryCacheResult* result,
+                             size_t i) {
+  const struct QueryCacheValue* value = &result->values[i];
+  switch(value->type) {
+    case QUERY_CACHE_NUM:
+      return NUM_VAL(value->number);
+    case QUERY_CACHE_STRING:
+      return wrenNewStringLength(vm, result->data + value->offset, value->length);
+    default:
+      return NULL_VAL;
+  }
+}
+
+// The rows of a result kept by the query cache, built as query_fetch() does.
+static ObjList* queryCachedRows(WrenVM* vm, const struct QueryCacheResult* result) {
+  ObjList* rows = wrenNewList(vm, 0);
+  wrenPushRoot(vm, (Obj*)rows);
+  ObjList* columns = wrenNewList(vm, result->columns);
+  for(int i = 0; i < result->columns; i++) {
+    columns->elements.data[i] = NULL_VAL;
+  }
+  wrenPushRoot(vm, (Obj*)columns);
+  for(int i = 0; i < result->columns; i++) {
+    columns->elements.data[i] = queryCacheValue(vm, result, i);
+  }
+
+  for(size_t at = result->columns; result->columns > 0 && at < result->count;
+      at += result->columns) {
+    ObjMap* row = wrenNewMap(vm);
+    wrenPushRoot(vm, (Obj*)row);
+    for(int i = 0; i < result->columns; i++) {
+      Value value = queryCacheValue(vm, result, at + i);
+      if(IS_OBJ(value))
+        wrenPushRoot(vm, AS_OBJ(value));
+      wrenMapSet(vm, row, columns->elements.data[i], value);
+      if(IS_OBJ(value))
+        wrenPopRoot(vm);
+    }
+    wrenPopRoot(vm);
+    wrenListInsert(vm, rows, OBJ_VAL(row), rows->elements.count);
+  }
+  wrenPopRoot(vm);
+  wrenPopRoot(vm);
+  return rows;
+}
+
+// Fetches like query_fetch(), first looking for the rows in the query cache
+// and storing them there for args[3] seconds when they were not. Only read
+// only statements that are not part of a transaction are stored, as rows read
+// inside one could still be rolled back.
+DEF_PRIMITIVE(query_fetchCached) {
+  if(!validateNum(vm, args[3], "Time to live"))
+    return false;
+  double     ttl = AS_NUM(args[3]);
+  ObjString* sql = AS_STRING(args[1]);
+  ObjList*   params = AS_LIST(args[2]);
+  size_t     key_len = 0;
+  char*      key = ttl > 0 ? queryCacheKey(sql, params, &key_len) : NULL;
+  if(key == NULL)
+    return prim_query_fetch(vm, args);
+
+  const struct QueryCacheResult* cached = query_cache_get(key, key_len, time(NULL));
+  if(cached != NULL) {
+    free(key);
+    RETURN_OBJ(queryCachedRows(vm, cached));
+  }
+
+  sqlite3_stmt* stmt = bialet_query_prepare(sql->value);
+  if(stmt == NULL) {
+    free(key);
+    RETURN_OBJ(wrenNewList(vm, 0));
+  }
+  if(!queryBind(vm, stmt, params)) {
+    free(key);
+    bialet_query_release(stmt, SQLITE_OK);
+    return false;
+  }
+
+  const char*              tables = bialet_query_reads(stmt);
+  struct QueryCacheResult* record = NULL;
+  int                      count = sqlite3_column_count(stmt);
+  if(tables != NULL && sqlite3_stmt_readonly(stmt) &&
+     sqlite3_get_autocommit(sqlite3_db_handle(stmt)))
+    record = query_cache_result_new(count);
+  for(int i = 0; record != NULL && i < count; i++) {
+    const char* name = sqlite3_column_name(stmt, i);
+    name = name != NULL ? name : "";
+    if(query_cache_result_add_string(record, name, strlen(name)) != 0) {
+      query_cache_result_free(record);
+      record = NULL;
+    }
+  }
+
+  ObjList* rows = wrenNewList(vm, 0);
+  wrenPushRoot(vm, (Obj*)rows);
+  ObjList* columns = NULL;
+  int      result;
+  while((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+    if(columns == NULL) {
+      columns = queryColumns(vm, stmt);
+      wrenPushRoot(vm, (Obj*)columns);
+    }
+    Value row = queryRow(vm, stmt, columns);
+    wrenListInsert(vm, rows, row, rows->elements.count);
+    // Too large to keep, the rest is still fetched.
+    for(int i = 0; record != NULL && i < count; i++) {
+      Value value = wrenMapGet(AS_MAP(row), columns->elements.data[i]);
+      if(queryCacheAdd(record, value) != 0) {
+        query_cache_result_free(record);
+        record = NULL;
+      }
+    }
+  }
+  if(columns != NULL)
+    wrenPopRoot(vm);
+  wrenPopRoot(vm);
+
+  if(record != NULL && result == SQLITE_DONE) {
+    query_cache_put(key, key_len, tables, time(NULL) + (time_t)ceil(fmin(ttl, 1e9)),
+                    record);
+  } else {
+    query_cache_result_free(record);
+  }
+  free(key);
+  bialet_query_release(stmt, result);
+  RETURN_OBJ(rows);
 }
 
 DEF_PRIMITIVE(query_execute) {
-  BialetQuery* query = create_bialet_query();
-  if(query == NULL)
-    RETURN_ERROR("Out of memory allocating query");
-  char* qs = strdup(AS_CSTRING(args[1]));
-  if(qs == NULL) {
-    free_bialet_query(query);
-    RETURN_ERROR("Out of memory allocating query string");
-  }
-  query->queryString = qs;
-  if(!queryPrepare(vm, query, AS_LIST(args[2]))) {
-    free_bialet_query(query);
-    return false;
-  }
-  if(query->lastInsertId) {
-    Value lastInsertId = wrenNewString(vm, query->lastInsertId);
-    free_bialet_query(query);
-    RETURN_VAL(lastInsertId);
+  sqlite3_stmt* stmt = bialet_query_prepare(AS_CSTRING(args[1]));
+  if(stmt == NULL)
+    RETURN_NULL;
+  if(!queryBind(vm, stmt, AS_LIST(args[2]))) {
+    bialet_query_release(stmt, SQLITE_OK);
+    return false;
+  }
+
+  int result;
+  while((result = sqlite3_step(stmt)) == SQLITE_ROW)
+    ;
+  // The last inserted ID stays a string, apps concatenate it into paths.
+  char id[MAX_NUMBER_LENGTH];
+  snprintf(id, sizeof(id), "%lld",
+           (long long)sqlite3_last_insert_rowid(sqlite3_db_handle(stmt)));
+  bialet_query_release(stmt, result);
+  RETURN_VAL(wrenNewString(vm, id));
+}
+
+// Runs [sql], a statement without parameters or rows such as BEGIN or COMMIT.
+static bool queryRun(const char* sql) {
+  sqlite3_stmt* stmt = bialet_query_prepare(sql);
+  if(stmt == NULL)
+    return false;
+  int result = sqlite3_step(stmt);
+  bialet_query_release(stmt, result);
+  return result == SQLITE_DONE;
+}
+
+// Runs the query once for each list of parameters in args[2], reusing one
+// statement. Outside a transaction the batch is its own, inside one it is a
+// savepoint of it, so either every row is written or none is. Returns the
+// number of rows changed, or null when a row failed and the batch was rolled
+// back.
+DEF_PRIMITIVE(query_batch) {
+  ObjList* paramLists = AS_LIST(args[2]);
+  if(paramLists->elements.count == 0)
+    RETURN_NUM(0);
+  sqlite3_stmt* stmt = bialet_query_prepare(AS_CSTRING(args[1]));
+  if(stmt == NULL)
+    RETURN_NULL;
+
+  sqlite3* db = sqlite3_db_handle(stmt);
+  bool     outer = sqlite3_get_autocommit(db);
+  if(!queryRun(outer ? "BEGIN IMMEDIATE" : "SAVEPOINT bialet_batch")) {
+    bialet_query_release(stmt, SQLITE_OK);
+    RETURN_NULL;
+  }
+
+  double changes = 0;
+  int    result = SQLITE_DONE;
+  bool   bound = true;
+  for(int i = 0; i < paramLists->elements.count; i++) {
+    if(!queryBind(vm, stmt, AS_LIST(paramLists->elements.data[i]))) {
+      bound = false;
+      break;
+    }
+    while((result = sqlite3_step(stmt)) == SQLITE_ROW)
+      ;
+    if(result != SQLITE_DONE)
+      break;
+    changes += sqlite3_changes(db);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+  }
+  bialet_query_release(stmt, result);
+
+  if(bound && result == SQLITE_DONE) {
+    queryRun(outer ? "COMMIT" : "RELEASE bialet_batch");
+    RETURN_NUM(changes);
+  }
+  if(outer) {
+    queryRun("ROLLBACK");
   } else {
-    free_bialet_query(query);
+    queryRun("ROLLBACK TO bialet_batch");
+    queryRun("RELEASE bialet_batch");
+  }
+  if(!bound)
+    return false;
+  RETURN_NULL;
+}
+
+DEF_PRIMITIVE(query_cursor) {
+  RETURN_VAL(wrenNewCursor(vm, args[1], AS_LIST(args[2])));
+}
+
+// Runs the query of [cursor] again from the first row.
+DEF_PRIMITIVE(cursor_restart) {
+  ObjCursor* cursor = AS_CURSOR(args[0]);
+  wrenCursorClose(vm, cursor, SQLITE_OK);
+  cursor->done = false;
+  cursor->columns = NULL;
+  cursor->row = NULL;
+  RETURN_VAL(args[0]);
+}
+
+// The next row, or null after the last one. With [reuse] the row is written
+// over the map of the previous one instead of a new map.
+DEF_PRIMITIVE(cursor_step) {
+  ObjCursor* cursor = AS_CURSOR(args[0]);
+  if(cursor->done)
     RETURN_NULL;
+  if(cursor->stmt == NULL) {
+    sqlite3_stmt* stmt = bialet_query_prepare(AS_CSTRING(cursor->query));
+    if(stmt == NULL) {
+      cursor->done = true;
+      RETURN_NULL;
+    }
+    if(!queryBind(vm, stmt, cursor->params)) {
+      bialet_query_release(stmt, SQLITE_OK);
+      cursor->done = true;
+      return false;
+    }
+    wrenCursorOpen(vm, cursor, stmt);
+  }
+
+  int result = sqlite3_step(cursor->stmt);
+  if(result != SQLITE_ROW) {
+    wrenCursorClose(vm, cursor, result);
+    cursor->done = true;
+    RETURN_NULL;
+  }
+  if(cursor->columns == NULL)
+    cursor->columns = queryColumns(vm, cursor->stmt);
+  if(!wrenIsFalsyValue(args[1]) && cursor->row != NULL) {
+    queryFillRow(vm, cursor->stmt, cursor->columns, cursor->row);
+  } else {
+    cursor->row = AS_MAP(queryRow(vm, cursor->stmt, cursor->columns));
   }
+  RETURN_OBJ(cursor->row);
+}
+
+DEF_PRIMITIVE(cursor_close) {
+  ObjCursor* cursor = AS_CURSOR(args[0]);
+  wrenCursorClose(vm, cursor, SQLITE_OK);
+  cursor->done = true;
+  RETURN_NULL;
 }
 
 DEF_PRIMITIVE(query_toString) {
@@ -1912,6 +2570,35 @@ DEF_PRIMITIVE(query_new) {
   RETURN_VAL(wrenNewQuery(vm, queryString));
 }
 
+// Runs one of the BEGIN, COMMIT, SAVEPOINT or ROLLBACK statements of
+// Db.transaction. A failure aborts the fiber: going on would run the rest of
+// the request outside the transaction it expects, or report a commit that did
+// not happen.
+DEF_PRIMITIVE(db_run) {
+  if(!validateString(vm, args[1], "Statement"))
+    return false;
+  if(!queryRun(AS_CSTRING(args[1])))
+    RETURN_ERROR_FMT("Transaction statement failed: @.", args[1]);
+  RETURN_NULL;
+}
+
+DEF_PRIMITIVE(db_cacheStats) {
+  long hits, misses, invalidations;
+  query_cache_stats(&hits, &misses, &invalidations);
+  ObjMap* stats = wrenNewMap(vm);
+  wrenPushRoot(vm, (Obj*)stats);
+  const char* names[] = {"hits", "misses", "invalidations"};
+  long        counts[] = {hits, misses, invalidations};
+  for(int i = 0; i < 3; i++) {
+    Value name = wrenNewString(vm, names[i]);
+    wrenPushRoot(vm, AS_OBJ(name));
+    wrenMapSet(vm, stats, name, NUM_VAL((double)counts[i]));
+    wrenPopRoot(vm);
+  }
+  wrenPopRoot(vm);
+  RETURN_OBJ(stats);
+}
+
 // Creates either the Object or Class class in the core module with [name].
 static ObjClass* defineClass(WrenVM* vm, ObjModule* module, const char* name) {
   ObjString* nameString = AS_STRING(wrenNewString(vm, name));
@@ -1990,7 +2677,7 @@ void wrenInitializeCore(WrenVM* vm) {
   //   '---------'   '-------------------'            -'
 
   // The rest of the classes can now be defined normally.
-  wrenInterpret(vm, NULL, coreModuleSource);
+  wrenInterpretCore(vm, "core", coreModuleSource, CORE_BYTECODE(core));
 
   vm->boolClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Bool"));
   PRIMITIVE(vm->boolClass, "toString", bool_toString);
@@ -2121,11 +2808,36 @@ void wrenInitializeCore(WrenVM* vm) {
   PRIMITIVE(vm->stringClass, "startsWith(_)", string_startsWith);
   PRIMITIVE(vm->stringClass, "toString", string_toString);
 
+  vm->stringBuilderClass =
+      AS_CLASS(wrenFindVariable(vm, coreModule, "StringBuilder"));
+  PRIMITIVE(vm->stringBuilderClass->obj.classObj, "new()", stringBuilder_new);
+  PRIMITIVE(vm->stringBuilderClass, "append_(_)", stringBuilder_append);
+  PRIMITIVE(vm->stringBuilderClass, "appendHtml_(_)", stringBuilder_appendHtml);
+  PRIMITIVE(vm->stringBuilderClass, "byteCount", stringBuilder_byteCount);
+  PRIMITIVE(vm->stringBuilderClass, "clear()", stringBuilder_clear);
+  PRIMITIVE(vm->stringBuilderClass, "toString", stringBuilder_toString);
+  PRIMITIVE(vm->stringBuilderClass, "toString(_)", stringBuilder_toStringCount);
+
   vm->queryClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Query"));
   PRIMITIVE(vm->queryClass->obj.classObj, "new(_)", query_new);
+  PRIMITIVE(vm->queryClass->obj.classObj, "numText_(_)", query_numText);
   PRIMITIVE(vm->queryClass, "toString", query_toString);
-  PRIMITIVE(vm->queryClass, "queryRaw_(_,_)", query_execute);
-  PRIMITIVE(vm->queryClass, "fetchRaw_(_,_)", query_fetch);
+  // CachedQuery copied the methods of Query when it was defined, before these.
+  ObjClass* queryClasses[] = {
+      vm->queryClass, AS_CLASS(wrenFindVariable(vm, coreModule, "CachedQuery"))};
+  for(int i = 0; i < 2; i++) {
+    PRIMITIVE(queryClasses[i], "queryRaw_(_,_)", query_execute);
+    PRIMITIVE(queryClasses[i], "fetchRaw_(_,_)", query_fetch);
+    PRIMITIVE(queryClasses[i], "valRaw_(_,_)", query_val);
+    PRIMITIVE(queryClasses[i], "cursorRaw_(_,_)", query_cursor);
+    PRIMITIVE(queryClasses[i], "batchRaw_(_,_)", query_batch);
+    PRIMITIVE(queryClasses[i], "cachedFetchRaw_(_,_,_)", query_fetchCached);
+  }
+
+  vm->cursorClass = AS_CLASS(wrenFindVariable(vm, coreModule, "QueryCursor"));
+  PRIMITIVE(vm->cursorClass, "restart_()", cursor_restart);
+  PRIMITIVE(vm->cursorClass, "step_(_)", cursor_step);
+  PRIMITIVE(vm->cursorClass, "close()", cursor_close);
 
   vm->listClass = AS_CLASS(wrenFindVariable(vm, coreModule, "List"));
   PRIMITIVE(vm->listClass->obj.classObj, "filled(_,_)", list_filled);
@@ -2192,7 +2904,8 @@ void wrenInitializeCore(WrenVM* vm) {
   }
 
   // Bialet classes
-  WrenInterpretResult bialetResult = wrenInterpret(vm, NULL, bialetModuleSource);
+  WrenInterpretResult bialetResult =
+      wrenInterpretCore(vm, "bialet", bialetModuleSource, CORE_BYTECODE(bialet));
   if(bialetResult != WREN_RESULT_SUCCESS) {
     fprintf(stderr, "ERROR: Failed to load bialet module: %d\n", bialetResult);
   }
@@ -2202,6 +2915,24 @@ void wrenInitializeCore(WrenVM* vm) {
   PRIMITIVE(utilClass->obj.classObj, "verify_(_,_)", util_verify);
   PRIMITIVE(utilClass->obj.classObj, "randomString_(_)", util_randomString);
   PRIMITIVE(utilClass->obj.classObj, "urlDecode_(_)", util_urlDecode);
+  PRIMITIVE(utilClass->obj.classObj, "urlEncode_(_)", util_urlEncode);
+  PRIMITIVE(utilClass->obj.classObj, "htmlEscape_(_)", util_htmlEscape);
+  PRIMITIVE(utilClass->obj.classObj, "stripControlChars_(_)",
+            util_stripControlChars);
+  PRIMITIVE(utilClass->obj.classObj, "headerValue_(_)", util_headerValue);
+  PRIMITIVE(utilClass->obj.classObj, "hexToDec_(_)", util_hexToDec);
+  PRIMITIVE(utilClass->obj.classObj, "toHex_(_)", util_toHex);
+  PRIMITIVE(utilClass->obj.classObj, "encodeBase64_(_)", util_encodeBase64);
+  PRIMITIVE(utilClass->obj.classObj, "decodeBase64_(_)", util_decodeBase64);
+
+  ObjClass* dbClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Db"));
+  PRIMITIVE(dbClass->obj.classObj, "cacheStats_()", db_cacheStats);
+  PRIMITIVE(dbClass->obj.classObj, "run_(_)", db_run);
+
+  ObjClass* requestClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Request"));
+  PRIMITIVE(requestClass->obj.classObj, "body_()", request_body);
+  PRIMITIVE(requestClass->obj.classObj, "form_(_)", request_form);
+  PRIMITIVE(requestClass->obj.classObj, "upload_(_)", request_upload);
 
   ObjClass* responseClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Response"));
   PRIMITIVE(responseClass->obj.classObj, "defaultPage_(_,_)", response_default_page);
@@ -2215,11 +2946,13 @@ void wrenInitializeCore(WrenVM* vm) {
 
   ObjClass* jsonClass = AS_CLASS(wrenFindVariable(vm, coreModule, "Json"));
   PRIMITIVE(jsonClass->obj.classObj, "parse_(_)", json_parse_primitive);
+  PRIMITIVE(jsonClass->obj.classObj, "stringify_(_)", json_stringify_primitive);
 
   // Conditionally load test classes
   if(vm->config.enableTests) {
     WrenInterpretResult testResult =
-        wrenInterpret(vm, NULL, bialet_testModuleSource);
+        wrenInterpretCore(vm, "bialet_test", bialet_testModuleSource,
+                          CORE_BYTECODE(bialet_test));
     if(testResult != WREN_RESULT_SUCCESS) {
       fprintf(stderr, "ERROR: Failed to load test module: %d\n", testResult);
     }
@@ -72,6 +72,12 @@ static void dumpObject(Obj* obj) {
     case OBJ_STRING:
       printf("%s", ((ObjString*)obj)->value);
       break;
+    case OBJ_STRING_BUILDER:
+      printf("[string builder %p]", obj);
+      break;
+    case OBJ_CURSOR:
+      printf("[cursor %p]", obj);
+      break;
     case OBJ_UPVALUE:
       printf("[upvalue %p]", obj);
       break;
@@ -5,6 +5,7 @@
 
 #include "wren_value.h"
 
+#include "bialet_wren.h"
 #include "wren.h"
 #include "wren_vm.h"
 
@@ -641,6 +642,77 @@ Value wrenNewRange(WrenVM* vm, double from, double to, bool isInclusive) {
   return OBJ_VAL(range);
 }
 
+Value wrenNewStringBuilder(WrenVM* vm) {
+  ObjStringBuilder* builder = ALLOCATE(vm, ObjStringBuilder);
+  initObj(vm, &builder->obj, OBJ_STRING_BUILDER, vm->stringBuilderClass);
+  builder->length = 0;
+  builder->capacity = 0;
+  builder->value = NULL;
+  return OBJ_VAL(builder);
+}
+
+bool wrenStringBuilderReserve(WrenVM* vm, ObjStringBuilder* builder, size_t extra) {
+  size_t needed = (size_t)builder->length + extra;
+  if(needed > UINT32_MAX)
+    return false;
+  if(needed <= builder->capacity)
+    return true;
+
+  size_t capacity = builder->capacity < 64 ? 64 : builder->capacity;
+  while(capacity < needed)
+    capacity *= 2;
+  if(capacity > UINT32_MAX)
+    capacity = UINT32_MAX;
+
+  builder->value = (char*)wrenReallocate(vm, builder->value, builder->capacity,
+                                         capacity);
+  builder->capacity = (uint32_t)capacity;
+  return true;
+}
+
+Value wrenNewCursor(WrenVM* vm, Value query, ObjList* params) {
+  ObjCursor* cursor = ALLOCATE(vm, ObjCursor);
+  initObj(vm, &cursor->obj, OBJ_CURSOR, vm->cursorClass);
+  cursor->query = query;
+  cursor->params = params;
+  cursor->columns = NULL;
+  cursor->row = NULL;
+  cursor->stmt = NULL;
+  cursor->done = false;
+  cursor->prevOpen = NULL;
+  cursor->nextOpen = NULL;
+  return OBJ_VAL(cursor);
+}
+
+void wrenCursorOpen(WrenVM* vm, ObjCursor* cursor, struct sqlite3_stmt* stmt) {
+  cursor->stmt = stmt;
+  cursor->prevOpen = NULL;
+  cursor->nextOpen = vm->openCursors;
+  if(vm->openCursors != NULL)
+    vm->openCursors->prevOpen = cursor;
+  vm->openCursors = cursor;
+}
+
+void wrenCursorClose(WrenVM* vm, ObjCursor* cursor, int result) {
+  if(cursor->stmt == NULL)
+    return;
+  bialet_query_release(cursor->stmt, result);
+  cursor->stmt = NULL;
+  if(cursor->prevOpen != NULL)
+    cursor->prevOpen->nextOpen = cursor->nextOpen;
+  else
+    vm->openCursors = cursor->nextOpen;
+  if(cursor->nextOpen != NULL)
+    cursor->nextOpen->prevOpen = cursor->prevOpen;
+  cursor->prevOpen = NULL;
+  cursor->nextOpen = NULL;
+}
+
+void wrenCloseCursors(WrenVM* vm) {
+  while(vm->openCursors != NULL)
+    wrenCursorClose(vm, vm->openCursors, SQLITE_OK);
+}
+
 // Creates a new string object with a null-terminated buffer large enough to
 // hold a string of [length] but does not fill in the bytes.
 //
@@ -989,7 +1061,7 @@ void wrenGrayObj(WrenVM* vm, Obj* obj) {
   if(vm->grayCount >= vm->grayCapacity) {
     vm->grayCapacity = vm->grayCount * 2;
     vm->gray = (Obj**)vm->config.reallocateFn(
-        vm->gray, vm->grayCapacity * sizeof(Obj*), vm->config.userData);
+        vm->gray, vm->grayCapacity * sizeof(Obj*), vm->config.reallocateUserData);
   }
 
   vm->gray[vm->grayCount++] = obj;
@@ -1165,6 +1237,21 @@ static void blackenQuery(WrenVM* vm, ObjString* string) {
   vm->bytesAllocated += sizeof(ObjString) + string->length + 1;
 }
 
+static void blackenStringBuilder(WrenVM* vm, ObjStringBuilder* builder) {
+  // Keep track of how much memory is still in use.
+  vm->bytesAllocated += sizeof(ObjStringBuilder) + builder->capacity;
+}
+
+static void blackenCursor(WrenVM* vm, ObjCursor* cursor) {
+  wrenGrayValue(vm, cursor->query);
+  wrenGrayObj(vm, (Obj*)cursor->params);
+  wrenGrayObj(vm, (Obj*)cursor->columns);
+  wrenGrayObj(vm, (Obj*)cursor->row);
+
+  // Keep track of how much memory is still in use.
+  vm->bytesAllocated += sizeof(ObjCursor);
+}
+
 static void blackenUpvalue(WrenVM* vm, ObjUpvalue* upvalue) {
   // Mark the closed-over object (in case it is closed).
   wrenGrayValue(vm, upvalue->closed);
@@ -1218,6 +1305,12 @@ static void blackenObject(WrenVM* vm, Obj* obj) {
     case OBJ_QUERY:
       blackenQuery(vm, (ObjString*)obj);
       break;
+    case OBJ_STRING_BUILDER:
+      blackenStringBuilder(vm, (ObjStringBuilder*)obj);
+      break;
+    case OBJ_CURSOR:
+      blackenCursor(vm, (ObjCursor*)obj);
+      break;
     case OBJ_UPVALUE:
       blackenUpvalue(vm, (ObjUpvalue*)obj);
       break;
@@ -1286,11 +1379,20 @@ void wrenFreeObj(WrenVM* vm, Obj* obj) {
       break;
 
     // Note: OBJ_QUERY objects are ObjString-based and don't hold database
-    // connections or statements. The sqlite3_stmt is created, used, and
-    // finalized within queryExecute() in bialet_wren.c, so no additional
-    // cleanup is needed here beyond the normal string object handling.
+    // connections or statements. The query primitives in wren_core.c take a
+    // statement and give it back before returning, and cursors close their
+    // own, so no additional cleanup is needed here beyond the normal string
+    // object handling.
     case OBJ_QUERY:
       break;
+
+    case OBJ_STRING_BUILDER:
+      DEALLOCATE(vm, ((ObjStringBuilder*)obj)->value);
+      break;
+
+    case OBJ_CURSOR:
+      wrenCursorClose(vm, (ObjCursor*)obj, SQLITE_OK);
+      break;
   }
 
   DEALLOCATE(vm, obj);
@@ -58,6 +58,8 @@
 #define AS_NUM(value) (wrenValueToNum(value))            // double
 #define AS_RANGE(v) ((ObjRange*)AS_OBJ(v))               // ObjRange*
 #define AS_STRING(v) ((ObjString*)AS_OBJ(v))             // ObjString*
+#define AS_STRING_BUILDER(v) ((ObjStringBuilder*)AS_OBJ(v)) // ObjStringBuilder*
+#define AS_CURSOR(v) ((ObjCursor*)AS_OBJ(v))             // ObjCursor*
 #define AS_CSTRING(v) (AS_STRING(v)->value)              // const char*
 
 // These macros promote a primitive C value to a full Wren Value. There are
@@ -80,6 +82,7 @@
 #define IS_MAP(value) (wrenIsObjType(value, OBJ_MAP))           // ObjMap
 #define IS_RANGE(value) (wrenIsObjType(value, OBJ_RANGE))       // ObjRange
 #define IS_STRING(value) (wrenIsObjType(value, OBJ_STRING))     // ObjString
+#define IS_STRING_BUILDER(value) (wrenIsObjType(value, OBJ_STRING_BUILDER)) // ObjStringBuilder
 
 // Creates a new string object from [text], which should be a bare C string
 // literal. This determines the length of the string automatically at compile
@@ -100,6 +103,8 @@ typedef enum {
   OBJ_RANGE,
   OBJ_STRING,
   OBJ_QUERY,
+  OBJ_STRING_BUILDER,
+  OBJ_CURSOR,
   OBJ_UPVALUE
 } ObjType;
 
@@ -469,6 +474,52 @@ typedef struct {
   bool isInclusive;
 } ObjRange;
 
+// Pages used to be built by concatenating strings, which copies everything
+// written so far on every `+`. A builder keeps the bytes in a buffer that
+// grows by doubling, so each piece is copied once when it is appended and once
+// more when the result is turned into a string.
+typedef struct {
+  Obj obj;
+
+  // The number of bytes written.
+  uint32_t length;
+
+  // The number of bytes allocated for [value].
+  uint32_t capacity;
+
+  char* value;
+} ObjStringBuilder;
+
+// A query read one row at a time, see Query.iter and Query.each. fetch used to
+// be the only way to read rows, and it builds every one before returning, so a
+// large table did not fit in memory.
+//
+// The statement is taken from the statement cache on the first step and given
+// back after the last row, by close(), or when the request that opened it ends,
+// whichever comes first. Open cursors are linked from the VM for that.
+typedef struct sObjCursor {
+  Obj obj;
+
+  // The query and its parameters, kept to run it again when the cursor is
+  // restarted. Bound strings point into [params].
+  Value query;
+  ObjList* params;
+
+  // The column names, made on the first row, and the map of the last row.
+  ObjList* columns;
+  ObjMap* row;
+
+  // NULL before the first step and once the cursor is closed.
+  struct sqlite3_stmt* stmt;
+
+  // Set when the last row was read, so stepping again does not run the query
+  // from the start.
+  bool done;
+
+  struct sObjCursor* prevOpen;
+  struct sObjCursor* nextOpen;
+} ObjCursor;
+
 // An IEEE 754 double-precision float is a 64-bit value with bits laid out like:
 //
 // 1 Sign bit
@@ -691,6 +742,27 @@ ObjModule* wrenNewModule(WrenVM* vm, ObjString* name);
 // Creates a new range from [from] to [to].
 Value wrenNewRange(WrenVM* vm, double from, double to, bool isInclusive);
 
+// Creates a new empty string builder.
+Value wrenNewStringBuilder(WrenVM* vm);
+
+// Makes room in [builder] for [extra] more bytes. Returns false if the result
+// would be longer than a string can be.
+bool wrenStringBuilderReserve(WrenVM* vm, ObjStringBuilder* builder, size_t extra);
+
+// Creates a cursor over [query] with [params], which does not run until the
+// first step.
+Value wrenNewCursor(WrenVM* vm, Value query, ObjList* params);
+
+// Marks [cursor] as open with [stmt].
+void wrenCursorOpen(WrenVM* vm, ObjCursor* cursor, struct sqlite3_stmt* stmt);
+
+// Gives the statement of [cursor] back, logging [result] if it was an error.
+// Does nothing if it is not open.
+void wrenCursorClose(WrenVM* vm, ObjCursor* cursor, int result);
+
+// Closes every open cursor, for when the request that opened them ends.
+void wrenCloseCursors(WrenVM* vm);
+
 // Creates a new string object and copies [text] into it.
 //
 // [text] must be non-NULL.
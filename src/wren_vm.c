@@ -51,13 +51,15 @@ void wrenInitConfiguration(WrenConfiguration* config) {
   config->minHeapSize = 1024 * 1024;
   config->heapGrowthPercent = 50;
   config->userData = NULL;
+  config->reallocateUserData = NULL;
+  config->enableModuleCache = false;
 }
 
 WrenVM* wrenNewVM(WrenConfiguration* config) {
   WrenReallocateFn reallocate = defaultReallocate;
   void*            userData = NULL;
   if(config != NULL) {
-    userData = config->userData;
+    userData = config->reallocateUserData;
     reallocate = config->reallocateFn ? config->reallocateFn : defaultReallocate;
   }
 
@@ -86,12 +88,18 @@ WrenVM* wrenNewVM(WrenConfiguration* config) {
 
   vm->modules = wrenNewMap(vm);
   wrenInitializeCore(vm);
+  if(vm->config.enableModuleCache)
+    vm->moduleCache = wrenNewMap(vm);
   return vm;
 }
 
 void wrenFreeVM(WrenVM* vm) {
   ASSERT(vm->methodNames.count > 0, "VM appears to have already been freed.");
 
+  // Give back the statements of open cursors before their neighbours in the
+  // open list are freed.
+  wrenCloseCursors(vm);
+
   // Free all of the GC objects.
   Obj* obj = vm->first;
   while(obj != NULL) {
@@ -101,7 +109,8 @@ void wrenFreeVM(WrenVM* vm) {
   }
 
   // Free up the GC gray set.
-  vm->gray = (Obj**)vm->config.reallocateFn(vm->gray, 0, vm->config.userData);
+  vm->gray =
+      (Obj**)vm->config.reallocateFn(vm->gray, 0, vm->config.reallocateUserData);
 
   // Tell the user if they didn't free any handles. We don't want to just free
   // them here because the host app may still have pointers to them that they
@@ -134,6 +143,7 @@ void wrenCollectGarbage(WrenVM* vm) {
   vm->bytesAllocated = 0;
 
   wrenGrayObj(vm, (Obj*)vm->modules);
+  wrenGrayObj(vm, (Obj*)vm->moduleCache);
 
   // Temporary roots.
   for(int i = 0; i < vm->numTempRoots; i++) {
@@ -217,7 +227,7 @@ void* wrenReallocate(WrenVM* vm, void* memory, size_t oldSize, size_t newSize) {
     wrenCollectGarbage(vm);
 #endif
 
-  return vm->config.reallocateFn(memory, newSize, vm->config.userData);
+  return vm->config.reallocateFn(memory, newSize, vm->config.reallocateUserData);
 }
 
 // Captures the local variable [local] into an [Upvalue]. If that local is
@@ -408,10 +418,124 @@ static ObjModule* getModule(WrenVM* vm, Value name) {
   return !IS_UNDEFINED(moduleValue) ? AS_MODULE(moduleValue) : NULL;
 }
 
+// The module cache stops once it holds this many modules and starts over.
+#define MODULE_CACHE_MAX 256
+
+// Each cache entry is a list: the module, a copy of its variables as they were
+// right after compiling, then for the module function and every function
+// nested in it, the function, a copy of its bytecode and a copy of its
+// constants. Running a module changes all three: it assigns the variables,
+// and binding a method to a subclass (wrenBindMethodCode) shifts field
+// offsets in the bytecode and stores the superclass among the constants. They
+// are put back before each reuse.
+static void moduleCacheAddFn(WrenVM* vm, ObjList* entry, ObjFn* fn) {
+  wrenValueBufferWrite(vm, &entry->elements, OBJ_VAL(fn));
+  Value code = wrenNewStringLength(vm, (const char*)fn->code.data, fn->code.count);
+  wrenPushRoot(vm, AS_OBJ(code));
+  wrenValueBufferWrite(vm, &entry->elements, code);
+  wrenPopRoot(vm);
+
+  ObjList* constants = wrenNewList(vm, fn->constants.count);
+  for(int i = 0; i < fn->constants.count; i++) {
+    constants->elements.data[i] = fn->constants.data[i];
+  }
+  wrenPushRoot(vm, (Obj*)constants);
+  wrenValueBufferWrite(vm, &entry->elements, OBJ_VAL(constants));
+  wrenPopRoot(vm);
+
+  for(int i = 0; i < fn->constants.count; i++) {
+    if(IS_FN(fn->constants.data[i]))
+      moduleCacheAddFn(vm, entry, AS_FN(fn->constants.data[i]));
+  }
+}
+
+static void moduleCacheStore(WrenVM* vm, Value key, ObjModule* module, ObjFn* fn) {
+  if(vm->moduleCache->count >= MODULE_CACHE_MAX)
+    wrenMapClear(vm, vm->moduleCache);
+
+  ObjList* entry = wrenNewList(vm, 0);
+  wrenPushRoot(vm, (Obj*)entry);
+  wrenValueBufferWrite(vm, &entry->elements, OBJ_VAL(module));
+  ObjList* variables = wrenNewList(vm, module->variables.count);
+  for(int i = 0; i < module->variables.count; i++) {
+    variables->elements.data[i] = module->variables.data[i];
+  }
+  wrenPushRoot(vm, (Obj*)variables);
+  wrenValueBufferWrite(vm, &entry->elements, OBJ_VAL(variables));
+  wrenPopRoot(vm);
+  moduleCacheAddFn(vm, entry, fn);
+  wrenMapSet(vm, vm->moduleCache, key, OBJ_VAL(entry));
+  wrenPopRoot(vm);
+}
+
+// Registers the cached module under [key] as [name] and returns a closure of
+// its function, or NULL when there is none. A module that grew variables
+// since it was cached (Meta.compile adds them at runtime) is compiled again.
+static ObjClosure* moduleCacheLoad(WrenVM* vm, Value key, Value name) {
+  Value cached = wrenMapGet(vm->moduleCache, key);
+  if(IS_UNDEFINED(cached))
+    return NULL;
+  ObjList*   entry = AS_LIST(cached);
+  ObjModule* module = AS_MODULE(entry->elements.data[0]);
+  ObjList*   variables = AS_LIST(entry->elements.data[1]);
+  if(variables->elements.count != module->variables.count) {
+    wrenMapRemoveKey(vm, vm->moduleCache, key);
+    return NULL;
+  }
+  memcpy(module->variables.data, variables->elements.data,
+         sizeof(Value) * (size_t)variables->elements.count);
+  for(int i = 2; i + 2 < entry->elements.count; i += 3) {
+    ObjFn*     fn = AS_FN(entry->elements.data[i]);
+    ObjString* code = AS_STRING(entry->elements.data[i + 1]);
+    ObjList*   constants = AS_LIST(entry->elements.data[i + 2]);
+    memcpy(fn->code.data, code->value, code->length);
+    memcpy(fn->constants.data, constants->elements.data,
+           sizeof(Value) * (size_t)constants->elements.count);
+  }
+
+  wrenPushRoot(vm, (Obj*)entry);
+  wrenMapSet(vm, vm->modules, name, OBJ_VAL(module));
+  ObjClosure* closure = wrenNewClosure(vm, AS_FN(entry->elements.data[2]));
+  wrenPopRoot(vm);
+  vm->moduleCacheHits++;
+  return closure;
+}
+
+// The cache key: a 64-bit FNV-1a hash and the length of [source], then the
+// module [name].
+static Value moduleCacheKey(WrenVM* vm, Value name, const char* source) {
+  uint64_t hash = 14695981039346656037ULL;
+  size_t   length = 0;
+  for(const char* c = source; *c != '\0'; c++, length++) {
+    hash ^= (uint8_t)*c;
+    hash *= 1099511628211ULL;
+  }
+  char prefix[48];
+  snprintf(prefix, sizeof(prefix), "%016llx:%zu:", (unsigned long long)hash, length);
+  return wrenStringFormat(vm, "$@", prefix, name);
+}
+
+void wrenClearModuleCache(WrenVM* vm) {
+  if(vm->moduleCache != NULL)
+    wrenMapClear(vm, vm->moduleCache);
+}
+
 static ObjClosure* compileInModule(WrenVM* vm, Value name, const char* source,
                                    bool isExpression, bool printErrors) {
   // See if the module has already been loaded.
   ObjModule* module = getModule(vm, name);
+  Value      cacheKey = NULL_VAL;
+  if(module == NULL && vm->moduleCache != NULL && !isExpression && IS_STRING(name)) {
+    // Kept as a root until the compiled module is stored under it: creating
+    // the module below can collect garbage.
+    cacheKey = moduleCacheKey(vm, name, source);
+    wrenPushRoot(vm, AS_OBJ(cacheKey));
+    ObjClosure* cached = moduleCacheLoad(vm, cacheKey, name);
+    if(cached != NULL) {
+      wrenPopRoot(vm);
+      return cached;
+    }
+  }
   if(module == NULL) {
     module = wrenNewModule(vm, AS_STRING(name));
 
@@ -436,6 +560,15 @@ static ObjClosure* compileInModule(WrenVM* vm, Value name, const char* source,
   }
 
   ObjFn* fn = wrenCompile(vm, module, source, isExpression, printErrors);
+  if(!IS_NULL(cacheKey)) {
+    if(fn != NULL) {
+      wrenPushRoot(vm, (Obj*)fn);
+      moduleCacheStore(vm, cacheKey, module, fn);
+      wrenPopRoot(vm);
+      vm->moduleCacheMisses++;
+    }
+    wrenPopRoot(vm);
+  }
   if(fn == NULL) {
     // TODO: Should we still store the module even if it didn't compile?
     return NULL;
@@ -1411,6 +1544,10 @@ WrenInterpretResult wrenInterpret(WrenVM* vm, const char* module,
   if(closure == NULL)
     return WREN_RESULT_COMPILE_ERROR;
 
+  return wrenInterpretClosure(vm, closure);
+}
+
+WrenInterpretResult wrenInterpretClosure(WrenVM* vm, ObjClosure* closure) {
   wrenPushRoot(vm, (Obj*)closure);
   ObjFiber* fiber = wrenNewFiber(vm, closure);
   wrenPopRoot(vm); // closure.
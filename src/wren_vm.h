@@ -39,6 +39,8 @@ struct WrenVM {
   ObjClass* rangeClass;
   ObjClass* stringClass;
   ObjClass* queryClass;
+  ObjClass* stringBuilderClass;
+  ObjClass* cursorClass;
 
   // The fiber that is currently running.
   ObjFiber* fiber;
@@ -88,6 +90,9 @@ struct WrenVM {
   // there are none.
   WrenHandle* handles;
 
+  // Cursors holding a statement, see ObjCursor.
+  ObjCursor* openCursors;
+
   // Pointer to the bottom of the range of stack slots available for use from
   // the C API. During a foreign method, this will be in the stack of the fiber
   // that is executing a method.
@@ -109,6 +114,12 @@ struct WrenVM {
   // There is a single global symbol table for all method names on all classes.
   // Method calls are dispatched directly by index in this table.
   SymbolTable methodNames;
+
+  // Compiled modules kept when config.enableModuleCache is set, or NULL. See
+  // compileInModule().
+  ObjMap* moduleCache;
+  int     moduleCacheHits;
+  int     moduleCacheMisses;
 };
 
 // A generic allocation function that handles all explicit memory management.
@@ -135,6 +146,9 @@ void wrenFinalizeForeign(WrenVM* vm, ObjForeign* foreign);
 // Creates a new [WrenHandle] for [value].
 WrenHandle* wrenMakeHandle(WrenVM* vm, Value value);
 
+// Runs [closure], the body of a module, in a new fiber.
+WrenInterpretResult wrenInterpretClosure(WrenVM* vm, ObjClosure* closure);
+
 // Compile [source] in the context of [module] and wrap in a fiber that can
 // execute it.
 //
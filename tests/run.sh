@@ -27,6 +27,7 @@ PORT="${args[2]:-7001}"
 ECHO_PORT="${args[3]:-7100}"
 SHOW_ERRORS_PORT="${args[4]:-7101}"
 DEV_PORT="${args[5]:-7102}"
+WORKERS_PORT="${args[6]:-7103}"
 
 source "$(dirname "$0")/util.sh"
 
@@ -123,6 +124,8 @@ run_test "Response headers            " "headers"         200 "headers-set"
 # Tests - Request & Response (extended coverage)
 run_test "Request uri and query alias " "request-meta?foo=bar" 200 "get|/request-meta|bar"
 run_test "Request body and header     " "request-meta" "foo=bar" 200 "form|/request-meta|foo=bar|application/x-www-form-urlencoded"
+run_test "Request query decoding      " "request-parse?a=x%20y+z&flag&c=1=2" 200 "x y z|true|1"
+run_test "Request form decoding       " "request-parse" "b=%41%4&a=%26" 200 "&|A%4"
 
 # Regression for the quadratic List.join/urlDecode DoS (DOS-001/DOS-002) and
 # the memory limit. A large newline-delimited POST used to stall the
@@ -156,6 +159,158 @@ else
     "Expected 200 under cap, 413 over cap, server alive. Got under:$under_code over:$over_code alive:$alive_code"
 fi
 
+# Slow client: a peer that sends half a request and stalls must not block
+# other clients. The old blocking reader held the worker for the whole body
+# deadline (30s); the event loop keeps it buffered and serves everyone else.
+slow_client_line=$LINENO
+exec 3<>"/dev/tcp/$HOST/$PORT"
+printf 'POST /post HTTP/1.1\r\nHost: %s\r\nContent-Length: 100\r\n\r\nab' "$HOST" >&3
+slow_code=$(curl -s -o /dev/null -w "%{http_code}" --max-time 3 \
+  "http://$HOST:$PORT/get?foo=bar")
+exec 3>&-
+if [[ "$slow_code" == "200" ]]; then
+  report_result "Slow client does not block" "$slow_client_line" 0
+else
+  report_result "Slow client does not block" "$slow_client_line" 1 \
+    "Expected 200 while another client stalls mid-body. Got: $slow_code"
+fi
+
+# Keep-alive and pipelining: curl reuses one connection for two requests, and
+# two pipelined requests sent in a single write get two responses, in order.
+keep_alive_line=$LINENO
+keep_alive_connects=$(curl -s -o /dev/null -w "%{num_connects}" \
+  "http://$HOST:$PORT/get?foo=a" -o /dev/null "http://$HOST:$PORT/get?foo=b")
+exec 3<>"/dev/tcp/$HOST/$PORT"
+printf 'GET /get?foo=one HTTP/1.1\r\nHost: %s\r\n\r\nGET /get?foo=two HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n' \
+  "$HOST" "$HOST" >&3
+pipelined=$(timeout 5 cat <&3 | tr -d '\r')
+exec 3>&-
+pipelined_ok=$(printf "%s" "$pipelined" | grep -o "HTTP/1.1 200" | wc -l | tr -d ' ')
+if [[ "$keep_alive_connects" == "10" && "$pipelined_ok" == "2" \
+      && "$pipelined" == *"one"*"two"* ]]; then
+  report_result "Keep-alive and pipelining" "$keep_alive_line" 0
+else
+  report_result "Keep-alive and pipelining" "$keep_alive_line" 1 \
+    "Expected 1 connect for 2 requests and 2 pipelined responses. Got connects:$keep_alive_connects responses:$pipelined_ok"
+fi
+
+# HEAD: the headers of the GET without its body, on a connection that stays
+# open for the request pipelined behind it.
+head_line=$LINENO
+exec 3<>"/dev/tcp/$HOST/$PORT"
+printf 'HEAD /get?foo=one HTTP/1.1\r\nHost: %s\r\n\r\nGET /get?foo=two HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n\r\n' \
+  "$HOST" "$HOST" >&3
+head_pipelined=$(timeout 5 cat <&3 | tr -d '\r')
+exec 3>&-
+head_ok=$(printf "%s" "$head_pipelined" | grep -o "HTTP/1.1 200" | wc -l | tr -d ' ')
+if [[ "$head_ok" == "2" && "$head_pipelined" != *"one"* && "$head_pipelined" == *"two"* ]]; then
+  report_result "HEAD without body" "$head_line" 0
+else
+  report_result "HEAD without body" "$head_line" 1 \
+    "Expected a bodiless HEAD response followed by the GET. Got: $head_pipelined"
+fi
+
+# Large static file: files are streamed straight from disk, so a payload far
+# bigger than the read buffer must arrive intact and with the right length.
+large_static_line=$LINENO
+large_static="$(dirname "$0")/large-static.bin"
+head -c 8000000 /dev/urandom > "$large_static"
+large_static_got="$(mktemp)"
+large_static_length=$(curl -s -o "$large_static_got" -w "%{size_download}" \
+  --max-time 10 "http://$HOST:$PORT/large-static.bin")
+if [[ "$large_static_length" == "8000000" ]] && cmp -s "$large_static" "$large_static_got"; then
+  report_result "Large static file" "$large_static_line" 0
+else
+  report_result "Large static file" "$large_static_line" 1 \
+    "Expected the 8000000 byte file unchanged. Got $large_static_length bytes"
+fi
+rm -f "$large_static" "$large_static_got"
+
+# Static cache: small files are answered from memory after the first hit,
+# and an edit must still show up on the next request.
+static_cache_line=$LINENO
+static_cache_file="$(dirname "$0")/static-cache.txt"
+echo "first" > "$static_cache_file"
+static_cache_first=$(curl -s "http://$HOST:$PORT/static-cache.txt")
+static_cache_again=$(curl -s "http://$HOST:$PORT/static-cache.txt")
+echo "second" > "$static_cache_file"
+sleep 1
+static_cache_second=$(curl -s "http://$HOST:$PORT/static-cache.txt")
+rm -f "$static_cache_file"
+if [[ "$static_cache_first" == "first" && "$static_cache_again" == "first" \
+      && "$static_cache_second" == "second" ]]; then
+  report_result "Static cache invalidation" "$static_cache_line" 0
+else
+  report_result "Static cache invalidation" "$static_cache_line" 1 \
+    "Expected first, first, second. Got $static_cache_first, $static_cache_again, $static_cache_second"
+fi
+
+# Conditional GET: a static file carries ETag and Last-Modified, and sending
+# either back gets a bodyless 304.
+conditional_line=$LINENO
+conditional_headers=$(curl -s -o /dev/null -D - "http://$HOST:$PORT/tags.html" | tr -d '\r')
+conditional_etag=$(printf "%s" "$conditional_headers" | grep -i "^ETag:" | cut -d' ' -f2)
+conditional_modified=$(printf "%s" "$conditional_headers" | grep -i "^Last-Modified:" \
+  | cut -d' ' -f2-)
+etag_code=$(curl -s -o /dev/null -w "%{http_code}" -H "If-None-Match: $conditional_etag" \
+  "http://$HOST:$PORT/tags.html")
+modified_code=$(curl -s -o /dev/null -w "%{http_code}" \
+  -H "If-Modified-Since: $conditional_modified" "http://$HOST:$PORT/tags.html")
+stale_code=$(curl -s -o /dev/null -w "%{http_code}" -H 'If-None-Match: "stale"' \
+  "http://$HOST:$PORT/tags.html")
+if [[ -n "$conditional_etag" && "$etag_code" == "304" && "$modified_code" == "304" \
+      && "$stale_code" == "200" ]]; then
+  report_result "Conditional GET" "$conditional_line" 0
+else
+  report_result "Conditional GET" "$conditional_line" 1 \
+    "Expected 304, 304, 200. Got etag:$etag_code modified:$modified_code stale:$stale_code"
+fi
+
+# Range requests: a static file and a Response.file() blob both answer a
+# byte range with 206 and just those bytes, and a range past the end with 416.
+range_line=$LINENO
+range_static=$(curl -s -r 1-3 -w "|%{http_code}" "http://$HOST:$PORT/tags.html")
+range_static_expected="$(head -c 4 "$(dirname "$0")/tags.html" | tail -c 3)|206"
+range_file_id=$(curl -s "http://$HOST:$PORT/file-create?create=1" | cut -d, -f1)
+range_file=$(curl -s -r 5-11 -w "|%{http_code}" \
+  "http://$HOST:$PORT/file-create?get=1&id=$range_file_id")
+range_past_end=$(curl -s -o /dev/null -r 100- -w "%{http_code}" \
+  "http://$HOST:$PORT/file-create?get=1&id=$range_file_id")
+if [[ "$range_static" == "$range_static_expected" && "$range_file" == "content|206" \
+      && "$range_past_end" == "416" ]]; then
+  report_result "Range requests" "$range_line" 0
+else
+  report_result "Range requests" "$range_line" 1 \
+    "Expected $range_static_expected, content|206 and 416. Got $range_static, $range_file and $range_past_end"
+fi
+
+# Compression: a static file is served from its precompressed .gz sibling when
+# the client accepts gzip, and a large dynamic page is gzipped on the fly.
+compression_line=$LINENO
+compression_static="$(dirname "$0")/compression.txt"
+compression_page="$(dirname "$0")/compression.wren"
+printf 'compressed %.0s' {1..200} > "$compression_static"
+gzip -c "$compression_static" > "$compression_static.gz"
+printf 'return "%s"\n' "$(printf 'dynamic %.0s' {1..200})" > "$compression_page"
+sleep 1
+compression_static_encoding=$(curl -s -o /dev/null -D - -H "Accept-Encoding: gzip" \
+  "http://$HOST:$PORT/compression.txt" | tr -d '\r' | grep -i "^Content-Encoding:")
+compression_static_body=$(curl -s --compressed "http://$HOST:$PORT/compression.txt")
+compression_plain=$(curl -s "http://$HOST:$PORT/compression.txt")
+compression_page_encoding=$(curl -s -o /dev/null -D - -H "Accept-Encoding: gzip" \
+  "http://$HOST:$PORT/compression" | tr -d '\r' | grep -i "^Content-Encoding:")
+compression_page_body=$(curl -s --compressed "http://$HOST:$PORT/compression")
+rm -f "$compression_static" "$compression_static.gz" "$compression_page"
+if [[ "$compression_static_encoding" == "Content-Encoding: gzip" \
+      && "$compression_page_encoding" == "Content-Encoding: gzip" \
+      && "$compression_static_body" == "compressed "* && "$compression_plain" == "compressed "* \
+      && "$compression_page_body" == "dynamic "* ]]; then
+  report_result "Response compression" "$compression_line" 0
+else
+  report_result "Response compression" "$compression_line" 1 \
+    "Expected gzip for the .gz sibling and the page. Got '$compression_static_encoding' and '$compression_page_encoding'"
+fi
+
 # Custom 413 error page: like 404/500, an oversized body is served the app's
 # own 413.html (or 413.wren) page via custom_error.
 custom_413_line=$LINENO
@@ -179,6 +334,7 @@ run_test "Response page escapes title " "response-page" 200 "Page&lt;title&gt;"
 run_test "Response page escapes msg   " "response-page" 200 "Hello &amp; welcome"
 run_test "Response out buffer         " "response-out"  200 "out:[first"
 run_test "Response out HTML literal   " "response-out-html" 200 "<p>hi</p>"
+run_test "String builder              " "string-builder" 200 "a1&lt;b&gt;&amp;&apos;&quot;|28|a1|<i>x</i>12|<i>x</i>13|<i>x</i>1|<p>&lt;<u>y</u>2</p>|10|<,i,>,x,<,/,i,>,1,2"
 run_test "Response headers getter     " "response-headers" 200 "custom:true|cookie:true"
 run_test "Response forbidden          " "response-errors?forbidden=1" 403
 run_test "Response notFound custom    " "response-errors?notfound=1" 404 "custom-404-page"
@@ -195,6 +351,15 @@ test_method "OPTIONS CORS preflight    " "OPTIONS" "cors" 204 "Access-Control-Al
 test_auth   "Login without credentials " "login-check" "" "" 401
 test_auth   "Login invalid credentials " "login-check" "admin" "wrong" 401
 test_auth   "Login valid credentials   " "login-check" "admin" "secret" 200 "authenticated"
+malformed_auth_line=$LINENO
+malformed_auth_code=$(curl -s -o /dev/null -w "%{http_code}" \
+  -H "Authorization: Basic not*base64" "http://$HOST:$PORT/login-check")
+if [[ "$malformed_auth_code" == "401" ]]; then
+  report_result "Login malformed credentials" "$malformed_auth_line" 0
+else
+  report_result "Login malformed credentials" "$malformed_auth_line" 1 \
+    "Expected: 401\tActual: $malformed_auth_code"
+fi
 
 # Tests - JSON & Parsing
 run_test "JSON response               " "json"            200 '{"foo":"bar"}'
@@ -219,6 +384,10 @@ run_test "Query non-primitive params  " "query-param-stringify" 200 "node-name|t
 run_test "Query to(Class) mapping     " "db-to-class"     200 "alpha:10,beta:20"
 run_test "Query RETURNING clause      " "db-returning"    200 "5,5,5"
 run_test "Db save delete migrate      " "db-more"         200 "inserted:"
+run_test "Query typed columns         " "db-types"        200 "true,43,true,1.5,true,7,3,true,true,42,integer,real,integer,true,1760659200123456,3.0,0.3,1760659200123456,0.30000000000000004"
+run_test "Query each and iter         " "db-cursor"       200 "abc,2,true,3,1 2 3,3,6,1,true"
+run_test "Db transaction and batch    " "db-transaction"  200 "100,true,100,done,50,undo,50,10,Transaction statement failed: COMMIT.,0"
+run_test "Query cached fetch          " "db-cache"        200 "one two,one two,one two three,uno,0,0,a b a,2 6 4,k1 k1 k2"
 
 # Tests - HTTP & External
 run_test "API call                    " "http"            200 "Adeel Solangi"
@@ -368,6 +537,97 @@ else
   skip_test "bialet dev starts" "requires local binary access"
 fi
 
+# Tests - multiple workers
+# `-W 3` must serve from every worker and, when one worker is killed, respawn
+# only that one while the others keep answering.
+if [[ "$TARGET_EXEC" != "-" ]]; then
+  workers_line=$LINENO
+  workers_root="$(dirname "$0")/echo"
+  $TARGET_EXEC -W 3 -h $HOST -p $WORKERS_PORT -l /tmp/tests-workers.log "$workers_root" \
+    > /dev/null 2>&1 &
+  workers_parent=$!
+  disown
+  sleep 1
+  workers_before=$(pgrep -P "$workers_parent" | wc -l)
+  workers_ok=0
+  for _ in 1 2 3 4 5 6; do
+    code=$(curl -s -o /dev/null -w "%{http_code}" -X POST -d "x=1" "http://$HOST:$WORKERS_PORT/echo")
+    [[ "$code" == "200" ]] && workers_ok=$((workers_ok + 1))
+  done
+  kill -9 "$(pgrep -P "$workers_parent" | head -n 1)" 2>/dev/null
+  sleep 1
+  workers_after=$(pgrep -P "$workers_parent" | wc -l)
+  workers_code=$(curl -s -o /dev/null -w "%{http_code}" -X POST -d "x=1" "http://$HOST:$WORKERS_PORT/echo")
+  # SIGTERM lets the supervisor forward the shutdown to its workers. Killing
+  # workers and supervisor together races a respawn and orphans a worker.
+  kill -TERM "$workers_parent" 2>/dev/null
+  sleep 1
+  pkill -9 -f "$TARGET_EXEC -W 3 -h $HOST -p $WORKERS_PORT" 2>/dev/null
+  if [[ "$workers_before" == "3" && "$workers_ok" == "6" && "$workers_after" == "3" \
+        && "$workers_code" == "200" ]]; then
+    report_result "Multiple workers respawn" "$workers_line" 0
+  else
+    report_result "Multiple workers respawn" "$workers_line" 1 \
+      "Expected 3 workers before and after a kill and 200s. Got before:$workers_before ok:$workers_ok after:$workers_after code:$workers_code"
+  fi
+else
+  skip_test "Multiple workers respawn" "requires local binary access"
+fi
+
+# Tests - Unix domain socket
+# `--socket` must answer over the socket file, shared by every worker, and
+# remove it on shutdown.
+if [[ "$TARGET_EXEC" != "-" ]]; then
+  socket_line=$LINENO
+  socket_path="/tmp/tests-bialet-$$.sock"
+  $TARGET_EXEC -W 2 --socket "$socket_path" -l /tmp/tests-socket.log \
+    "$(dirname "$0")/echo" > /dev/null 2>&1 &
+  socket_parent=$!
+  disown
+  sleep 1
+  socket_code=$(curl -s -o /dev/null -w "%{http_code}" --unix-socket "$socket_path" \
+    -X POST -d "x=1" "http://localhost/echo")
+  kill -TERM "$socket_parent" 2>/dev/null
+  sleep 1
+  if [[ "$socket_code" == "200" && ! -e "$socket_path" ]]; then
+    report_result "Unix domain socket" "$socket_line" 0
+  else
+    report_result "Unix domain socket" "$socket_line" 1 \
+      "Expected 200 and the socket removed. Got code:$socket_code"
+  fi
+  rm -f "$socket_path"
+else
+  skip_test "Unix domain socket" "requires local binary access"
+fi
+
+# Tests - Arena
+# `--arena` serves each request on a fresh VM and logs the high-water mark of
+# every route when the worker stops.
+if [[ "$TARGET_EXEC" != "-" ]]; then
+  arena_line=$LINENO
+  arena_port=$((20000 + $$ % 20000))
+  arena_log="/tmp/tests-arena-$$.log"
+  $TARGET_EXEC --arena -p "$arena_port" -l "$arena_log" "$(dirname "$0")/echo" \
+    > /dev/null 2>&1 &
+  arena_pid=$!
+  disown
+  sleep 1
+  arena_body=$(curl -s -X POST -d "x=1" "http://127.0.0.1:$arena_port/echo")
+  arena_code=$(curl -s -o /dev/null -w "%{http_code}" "http://127.0.0.1:$arena_port/echo")
+  kill -TERM "$arena_pid" 2>/dev/null
+  sleep 1
+  if [[ "$arena_body" == *POST* && "$arena_code" == "200" ]] &&
+     grep -q "Arena /echo.wren peak" "$arena_log"; then
+    report_result "Arena" "$arena_line" 0
+  else
+    report_result "Arena" "$arena_line" 1 \
+      "Expected the echo page and an arena report. Got code:$arena_code"
+  fi
+  rm -f "$arena_log"
+else
+  skip_test "Arena" "requires local binary access"
+fi
+
 finish
 print_summary >&2
 
@@ -0,0 +1,83 @@
+// Compiles the core Wren modules (wren_core.wren, bialet.wren and
+// bialet_test.wren) and writes the bytecode of each as a C array, for
+// wren_core.c to load instead of compiling the sources on every new VM.
+//
+// Built by the Makefile from the same objects as bialet, with a wren_core.c
+// that has no precompiled bytecode of its own.
+//
+//   wren_precompile build/gen/wren_core.bytecode.inc
+
+#include "wren.h"
+#include "wren_bytecode.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODULES 3
+
+static FILE* out;
+static int   captured = 0;
+static int   failed = 0;
+
+static void capture(const char* name, const uint8_t* data, size_t size) {
+  if(data == NULL) {
+    fprintf(stderr, "Could not serialize the bytecode of %s\n", name);
+    failed = 1;
+    return;
+  }
+  fprintf(out, "static const uint8_t %sModuleBytecode[%zu] = {", name, size);
+  for(size_t i = 0; i < size; i++) {
+    fprintf(out, "%s%u,", i % 20 == 0 ? "\n  " : "", data[i]);
+  }
+  fprintf(out, "\n};\n");
+  captured++;
+}
+
+static void write_error(WrenVM* vm, WrenErrorType type, const char* module,
+                        int line, const char* message) {
+  (void)vm;
+  (void)type;
+  fprintf(stderr, "%s:%d %s\n", module ? module : "core", line, message);
+}
+
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    fprintf(stderr, "Usage: %s OUTPUT\n", argv[0]);
+    return 1;
+  }
+
+  // Written next to the output and renamed, so a failed run does not leave a
+  // truncated file that make would consider up to date.
+  char tmp[4096];
+  if(snprintf(tmp, sizeof(tmp), "%s.tmp", argv[1]) >= (int)sizeof(tmp)) {
+    fprintf(stderr, "Output path too long\n");
+    return 1;
+  }
+  out = fopen(tmp, "w");
+  if(out == NULL) {
+    perror(tmp);
+    return 1;
+  }
+  fprintf(out, "// Generated automatically by tools/wren_precompile.c. Do not "
+               "edit.\n");
+
+  wrenBytecodeCapture = capture;
+  WrenConfiguration config;
+  wrenInitConfiguration(&config);
+  config.errorFn = write_error;
+  config.enableTests = true;
+  WrenVM* vm = wrenNewVM(&config);
+  wrenFreeVM(vm);
+
+  if(fclose(out) != 0 || failed || captured != MODULES) {
+    fprintf(stderr, "Could not precompile the core modules\n");
+    remove(tmp);
+    return 1;
+  }
+  if(rename(tmp, argv[1]) != 0) {
+    perror(argv[1]);
+    remove(tmp);
+    return 1;
+  }
+  return 0;
+}